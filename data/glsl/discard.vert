@@ -1,4 +1,6 @@
+#include "glsl/node.vert"
+
 void main()
 {
-    gl_Position = ftransform();
+    gl_Position = gl_ModelViewProjectionMatrix * node_vertex(gl_Vertex);
 }
@@ -0,0 +1,52 @@
+// Node transformation.  Under multi-draw, a pool draws many nodes at once and
+// each draw gives the index of its node's transform as its base instance.
+// Otherwise, the node transform is already part of the model-view matrix.
+// Normals take the inverse transpose, valid under non-uniform scale, while
+// tangents lie in the surface and take the transform itself.
+
+#ifdef INDIRECT
+
+struct Node
+{
+    mat4 Matrix;
+    mat4 NormalMatrix;
+};
+
+layout(std430, binding = 0) readonly buffer NodeTransform
+{
+    Node NodeData[];
+};
+
+vec4 node_vertex(vec4 v)
+{
+    return NodeData[gl_BaseInstanceARB].Matrix * v;
+}
+
+vec3 node_normal(vec3 n)
+{
+    return mat3(NodeData[gl_BaseInstanceARB].NormalMatrix) * n;
+}
+
+vec3 node_tangent(vec3 t)
+{
+    return mat3(NodeData[gl_BaseInstanceARB].Matrix) * t;
+}
+
+#else
+
+vec4 node_vertex(vec4 v)
+{
+    return v;
+}
+
+vec3 node_normal(vec3 n)
+{
+    return n;
+}
+
+vec3 node_tangent(vec3 t)
+{
+    return t;
+}
+
+#endif
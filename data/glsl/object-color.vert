@@ -1,5 +1,7 @@
 #version 120
 
+#include "glsl/node.vert"
+
 attribute vec3 Tangent;
 
 uniform vec4  LightPosition[4];
@@ -19,13 +21,14 @@ void main()
 {
     // Calculate the tangent space transform and inverse.
 
-    vec3 t = normalize(gl_NormalMatrix * Tangent);
-    vec3 n = normalize(gl_NormalMatrix * gl_Normal);
+    vec3 t = normalize(gl_NormalMatrix * node_tangent(Tangent));
+    vec3 n = normalize(gl_NormalMatrix * node_normal(gl_Normal));
 
     mat3 I = mat3(t, cross(n, t), n);
     mat3 T = transpose(I);
 
-    vec4 e = gl_ModelViewMatrix * gl_Vertex;
+    vec4 v = node_vertex(gl_Vertex);
+    vec4 e = gl_ModelViewMatrix * v;
 
     // Tangent-space view vector
 
@@ -48,5 +51,5 @@ void main()
     // Built-in vertex position and texture coordinate
 
     gl_TexCoord[0] = gl_MultiTexCoord0;
-    gl_Position    = gl_ModelViewProjectionMatrix * gl_Vertex;
+    gl_Position    = gl_ModelViewProjectionMatrix * v;
 }
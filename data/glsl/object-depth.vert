@@ -1,6 +1,7 @@
+#include "glsl/node.vert"
 
 void main()
 {
     gl_TexCoord[0] = gl_MultiTexCoord0;
-    gl_Position    = ftransform();
+    gl_Position    = gl_ModelViewProjectionMatrix * node_vertex(gl_Vertex);
 }
@@ -0,0 +1,458 @@
+/* Bake a PNG texture and its mipmaps into a block-compressed KTX container. */
+
+/* png2dds [-f bc1|bc3|bc5] input.png output.ktx                           */
+/*                                                                          */
+/* Mipmaps are box filtered down to 1x1. Any per-level scale and gamma      */
+/* options given in the XML file accompanying the PNG are applied, as the   */
+/* texture loader would apply them at run time. Rows are stored bottom to   */
+/* top, in OpenGL order, so the loader need not flip any level of any size. */
+/* By default, opaque images are stored as BC1 and others as BC3.           */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <png.h>
+#include <mxml.h>
+
+#define MAXLEVEL 32
+
+/*---------------------------------------------------------------------------*/
+
+static int   w;
+static int   h;
+static int   c;
+static float  scale[MAXLEVEL][4];
+static double gamma_exp = 1.0;
+
+/* Read a PNG, expanded to RGBA, with rows from top to bottom. */
+
+static unsigned char *read_png(const char *name)
+{
+    unsigned char *p = 0;
+    png_structp   rp = 0;
+    png_infop     ip = 0;
+    png_bytep    *bp = 0;
+    FILE         *fp = 0;
+    int i, j, k;
+
+    if ((fp = fopen(name, "rb")) == 0)
+        return 0;
+
+    if ((rp = png_create_read_struct(PNG_LIBPNG_VER_STRING, 0, 0, 0)) &&
+        (ip = png_create_info_struct(rp)))
+    {
+        if (setjmp(png_jmpbuf(rp)) == 0)
+        {
+            png_init_io(rp, fp);
+            png_read_png(rp, ip, PNG_TRANSFORM_EXPAND   |
+                                 PNG_TRANSFORM_PACKING  |
+                                 PNG_TRANSFORM_STRIP_16, 0);
+
+            w = (int) png_get_image_width (rp, ip);
+            h = (int) png_get_image_height(rp, ip);
+            c = (int) png_get_channels    (rp, ip);
+
+            if ((p = (unsigned char *) malloc(w * h * 4)) &&
+                (bp = png_get_rows(rp, ip)))
+
+                for (i = 0; i < h; ++i)
+                    for (j = 0; j < w; ++j)
+                    {
+                        const png_bytep s = bp[i] + j * c;
+                        unsigned char  *d = p + (i * w + j) * 4;
+
+                        switch (c)
+                        {
+                        case 1: d[0] = d[1] = d[2] = s[0]; d[3] = 255;  break;
+                        case 2: d[0] = d[1] = d[2] = s[0]; d[3] = s[1]; break;
+                        case 3: for (k = 0; k < 3; ++k) d[k] = s[k];
+                                d[3] = 255; break;
+                        case 4: for (k = 0; k < 4; ++k) d[k] = s[k]; break;
+                        }
+                    }
+        }
+    }
+    png_destroy_read_struct(&rp, &ip, 0);
+    fclose(fp);
+    return p;
+}
+
+/* Read the options of the XML file accompanying the named PNG. */
+
+static void read_opt(const char *name)
+{
+    char        path[FILENAME_MAX];
+    char       *dot;
+    mxml_node_t *root;
+    mxml_node_t *node;
+    FILE        *fp;
+    int l, k;
+
+    for (l = 0; l < MAXLEVEL; ++l)
+        for (k = 0; k < 4; ++k)
+            scale[l][k] = 1.0f;
+
+    strncpy(path, name, FILENAME_MAX - 5);
+    path[FILENAME_MAX - 5] = 0;
+
+    if ((dot = strrchr(path, '.')))
+        *dot = 0;
+
+    strcat(path, ".xml");
+
+    if ((fp = fopen(path, "r")))
+    {
+        if ((root = mxmlLoadFile(0, fp, MXML_NO_CALLBACK)))
+        {
+            for (node = mxmlFindElement(root, root, "option", "name", "scale",
+                                        MXML_DESCEND); node;
+                 node = mxmlFindElement(node, root, "option", "name", "scale",
+                                        MXML_DESCEND))
+            {
+                static const char *attr[4] = { "red", "green", "blue", "alpha" };
+
+                const char *v = mxmlElementGetAttr(node, "level");
+
+                if ((l = v ? atoi(v) : 0) >= 0 && l < MAXLEVEL)
+                    for (k = 0; k < 4; ++k)
+                        if ((v = mxmlElementGetAttr(node, attr[k])))
+                            scale[l][k] = (float) atof(v);
+            }
+            if ((node = mxmlFindElement(root, root, "option", "name", "gamma",
+                                        MXML_DESCEND)))
+            {
+                const char *v = mxmlElementGetAttr(node, "value");
+
+                if (v) gamma_exp = atof(v);
+            }
+            mxmlDelete(root);
+        }
+        fclose(fp);
+    }
+}
+
+/*---------------------------------------------------------------------------*/
+
+/* Box filter an RGBA image to half size, clamping at the edges. With a */
+/* gamma option, color is averaged in linear space.                     */
+
+static double linear(int v)
+{
+    return pow(v / 255.0, gamma_exp);
+}
+
+static void downsample(const unsigned char *p, int W, int H,
+                             unsigned char *q, int w, int h)
+{
+    int i, j, k;
+
+    for         (i = 0; i < h; ++i)
+        for     (j = 0; j < w; ++j)
+            for (k = 0; k < 4; ++k)
+            {
+                const int i0 = 2 * i, i1 = (2 * i + 1 < H) ? 2 * i + 1 : 2 * i;
+                const int j0 = 2 * j, j1 = (2 * j + 1 < W) ? 2 * j + 1 : 2 * j;
+
+                const int a = p[(i0 * W + j0) * 4 + k];
+                const int b = p[(i0 * W + j1) * 4 + k];
+                const int c = p[(i1 * W + j0) * 4 + k];
+                const int d = p[(i1 * W + j1) * 4 + k];
+
+                if (gamma_exp != 1.0 && k < 3)
+                    q[(i * w + j) * 4 + k] = (unsigned char)
+                        (pow((linear(a) + linear(b) +
+                              linear(c) + linear(d)) / 4, 1.0 / gamma_exp) * 255 + 0.5);
+                else
+                    q[(i * w + j) * 4 + k] = (unsigned char) ((a + b + c + d) / 4);
+            }
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void put16(unsigned char *p, unsigned int v)
+{
+    p[0] = (unsigned char) (v      );
+    p[1] = (unsigned char) (v >>  8);
+}
+
+static void put32(unsigned char *p, unsigned int v)
+{
+    p[0] = (unsigned char) (v      );
+    p[1] = (unsigned char) (v >>  8);
+    p[2] = (unsigned char) (v >> 16);
+    p[3] = (unsigned char) (v >> 24);
+}
+
+/* Encode a BC1 color block from 16 RGBA pixels. The endpoints span the inset */
+/* bounding box of the block's colors, and each pixel takes the nearest of    */
+/* the four interpolants.                                                     */
+
+static void encode_color(const unsigned char *p, unsigned char *b)
+{
+    int lo[3] = { 255, 255, 255 };
+    int hi[3] = {   0,   0,   0 };
+    int pal[4][3];
+    unsigned int c0, c1, bits = 0;
+    int i, k;
+
+    for (i = 0; i < 16; ++i)
+        for (k = 0; k < 3; ++k)
+        {
+            if (lo[k] > p[i * 4 + k]) lo[k] = p[i * 4 + k];
+            if (hi[k] < p[i * 4 + k]) hi[k] = p[i * 4 + k];
+        }
+
+    for (k = 0; k < 3; ++k)
+    {
+        const int d = (hi[k] - lo[k]) >> 4;
+        lo[k] += d;
+        hi[k] -= d;
+    }
+
+    c0 = ((hi[0] >> 3) << 11) | ((hi[1] >> 2) << 5) | (hi[2] >> 3);
+    c1 = ((lo[0] >> 3) << 11) | ((lo[1] >> 2) << 5) | (lo[2] >> 3);
+
+    pal[0][0] = ((c0 >> 11) & 31) * 255 / 31;
+    pal[0][1] = ((c0 >>  5) & 63) * 255 / 63;
+    pal[0][2] = ((c0      ) & 31) * 255 / 31;
+    pal[1][0] = ((c1 >> 11) & 31) * 255 / 31;
+    pal[1][1] = ((c1 >>  5) & 63) * 255 / 63;
+    pal[1][2] = ((c1      ) & 31) * 255 / 31;
+
+    for (k = 0; k < 3; ++k)
+    {
+        pal[2][k] = (2 * pal[0][k] + pal[1][k]) / 3;
+        pal[3][k] = (pal[0][k] + 2 * pal[1][k]) / 3;
+    }
+
+    if (c0 != c1)
+        for (i = 0; i < 16; ++i)
+        {
+            int best = 0, dmin = 1 << 30, j;
+
+            for (j = 0; j < 4; ++j)
+            {
+                int d = 0;
+
+                for (k = 0; k < 3; ++k)
+                    d += (p[i * 4 + k] - pal[j][k]) * (p[i * 4 + k] - pal[j][k]);
+
+                if (d < dmin) { dmin = d; best = j; }
+            }
+            bits |= (unsigned int) best << (2 * i);
+        }
+
+    put16(b + 0, c0);
+    put16(b + 2, c1);
+    put32(b + 4, bits);
+}
+
+/* Encode a BC4 block from channel k of 16 RGBA pixels, with the endpoints at */
+/* the extremes and each pixel taking the nearest of the eight interpolants.  */
+
+static void encode_alpha(const unsigned char *p, int k, unsigned char *b)
+{
+    int lo = 255, hi = 0, pal[8], i, j, n = 0;
+    unsigned int bits[2] = { 0, 0 };
+
+    for (i = 0; i < 16; ++i)
+    {
+        if (lo > p[i * 4 + k]) lo = p[i * 4 + k];
+        if (hi < p[i * 4 + k]) hi = p[i * 4 + k];
+    }
+
+    pal[0] = hi;
+    pal[1] = lo;
+
+    for (j = 1; j < 7; ++j)
+        pal[j + 1] = ((7 - j) * hi + j * lo) / 7;
+
+    if (hi != lo)
+        for (i = 0; i < 16; ++i, n += 3)
+        {
+            int best = 0, dmin = 256;
+
+            for (j = 0; j < 8; ++j)
+            {
+                int d = abs(p[i * 4 + k] - pal[j]);
+                if (d < dmin) { dmin = d; best = j; }
+            }
+            if (n < 24)
+                bits[0] |= (unsigned int) best << n;
+            else
+                bits[1] |= (unsigned int) best << (n - 24);
+        }
+
+    b[0] = (unsigned char) hi;
+    b[1] = (unsigned char) lo;
+    b[2] = (unsigned char) (bits[0]      );
+    b[3] = (unsigned char) (bits[0] >>  8);
+    b[4] = (unsigned char) (bits[0] >> 16);
+    b[5] = (unsigned char) (bits[1]      );
+    b[6] = (unsigned char) (bits[1] >>  8);
+    b[7] = (unsigned char) (bits[1] >> 16);
+}
+
+/* Encode a top-down RGBA image in bottom-up block order, padding partial */
+/* blocks by repeating edge pixels.                                       */
+
+static unsigned char *encode(const unsigned char *p, int w, int h, int f,
+                             size_t *len)
+{
+    const int bw = (w + 3) / 4;
+    const int bh = (h + 3) / 4;
+    const int bs = (f == 1) ? 8 : 16;
+
+    unsigned char *d = (unsigned char *) malloc(bw * bh * bs);
+    unsigned char  q[64];
+    int bi, bj, i, j;
+
+    for     (bi = 0; bi < bh; ++bi)
+        for (bj = 0; bj < bw; ++bj)
+        {
+            unsigned char *b = d + (bi * bw + bj) * bs;
+
+            for     (i = 0; i < 4; ++i)
+                for (j = 0; j < 4; ++j)
+                {
+                    const int y = (bi * 4 + i < h) ? bi * 4 + i : h - 1;
+                    const int x = (bj * 4 + j < w) ? bj * 4 + j : w - 1;
+
+                    memcpy(q + (i * 4 + j) * 4, p + ((h - 1 - y) * w + x) * 4, 4);
+                }
+
+            switch (f)
+            {
+            case 1: encode_color(q,    b);                           break;
+            case 3: encode_alpha(q, 3, b); encode_color(q,    b + 8); break;
+            case 5: encode_alpha(q, 0, b); encode_alpha(q, 1, b + 8); break;
+            }
+        }
+
+    *len = (size_t) (bw * bh * bs);
+    return d;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static int usage(const char *prog)
+{
+    fprintf(stderr, "Usage: %s [-f bc1|bc3|bc5] input.png output.ktx\n", prog);
+    return 1;
+}
+
+int main(int argc, char **argv)
+{
+    static const unsigned char id[12] = {
+        0xAB, 0x4B, 0x54, 0x58, 0x20, 0x31, 0x31, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A
+    };
+
+    unsigned char  head[64];
+    unsigned char  size[4];
+    unsigned char *p;
+    unsigned char *q;
+    const char *in;
+    const char *out;
+    FILE *fp;
+    int f = 0, n = 1, l, i, k, a = 1;
+
+    /* Parse the command line. */
+
+    if (argc > 2 && strcmp(argv[a], "-f") == 0)
+    {
+        if      (strcmp(argv[a + 1], "bc1") == 0) f = 1;
+        else if (strcmp(argv[a + 1], "bc3") == 0) f = 3;
+        else if (strcmp(argv[a + 1], "bc5") == 0) f = 5;
+        else return usage(argv[0]);
+        a += 2;
+    }
+    if (argc - a != 2)
+        return usage(argv[0]);
+
+    in  = argv[a + 0];
+    out = argv[a + 1];
+
+    /* Load the image and its options.  Choose a format by its opacity. */
+
+    if ((p = read_png(in)) == 0)
+    {
+        fprintf(stderr, "%s: Failed to read %s\n", argv[0], in);
+        return 1;
+    }
+    read_opt(in);
+
+    if (f == 0)
+        f = (c == 1 || c == 3) ? 1 : 3;
+
+    while ((w >> n) > 0 || (h >> n) > 0)
+        n++;
+
+    /* Write the header. */
+
+    memset(head, 0, sizeof (head));
+    memcpy(head, id, sizeof (id));
+
+    put32(head + 12, 0x04030201);                 /* Endianness             */
+    put32(head + 20, 1);                          /* Type size              */
+    put32(head + 28, f == 1 ? 0x83F0 :            /* RGB_S3TC_DXT1          */
+                    (f == 3 ? 0x83F3 : 0x8DBD));  /* RGBA_S3TC_DXT5, RG_RGTC2 */
+    put32(head + 32, f == 1 ? 0x1907 :            /* RGB                    */
+                    (f == 3 ? 0x1908 : 0x8227));  /* RGBA, RG               */
+    put32(head + 36, w);
+    put32(head + 40, h);
+    put32(head + 52, 1);                          /* Faces                  */
+    put32(head + 56, n);
+
+    if ((fp = fopen(out, "wb")) == 0)
+    {
+        fprintf(stderr, "%s: Failed to write %s\n", argv[0], out);
+        return 1;
+    }
+    fwrite(head, 1, sizeof (head), fp);
+
+    /* Write each level, scaled and rounded, then reduce the unscaled image. */
+    /* Luminance takes the red scale, as it does in the texture loader.      */
+
+    for (l = 0; l < n; ++l)
+    {
+        const int ww = (w >> l) ? (w >> l) : 1;
+        const int hh = (h >> l) ? (h >> l) : 1;
+
+        unsigned char *s = (unsigned char *) malloc(ww * hh * 4);
+        unsigned char *d;
+        size_t len;
+
+        for (i = 0; i < ww * hh; ++i)
+            for (k = 0; k < 4; ++k)
+            {
+                const int   j = (c < 3 && k < 3) ? 0 : k;
+                const float v = p[i * 4 + k] * (l < MAXLEVEL ? scale[l][j] : 1.0f)
+                              + 0.5f;
+                s[i * 4 + k] = (unsigned char) (v < 0 ? 0 : (v > 255 ? 255 : v));
+            }
+
+        d = encode(s, ww, hh, f, &len);
+        put32(size, (unsigned int) len);
+        fwrite(size, 1, 4, fp);
+        fwrite(d, 1, len, fp);
+        free(d);
+        free(s);
+
+        if (l < n - 1)
+        {
+            const int w2 = (ww >> 1) ? (ww >> 1) : 1;
+            const int h2 = (hh >> 1) ? (hh >> 1) : 1;
+
+            q = (unsigned char *) malloc(w2 * h2 * 4);
+            downsample(p, ww, hh, q, w2, h2);
+            free(p);
+            p = q;
+        }
+    }
+
+    fclose(fp);
+    free(p);
+    return 0;
+}
@@ -23,8 +23,11 @@ namespace app
 
     class file_buffer : public buffer
     {
+        bool mapped;
+
     public:
         file_buffer(std::string);
+       ~file_buffer();
     };
 
     // File system data archive
@@ -39,7 +42,8 @@ namespace app
         file_archive(std::string path, bool writable=false, int p=0);
 
         virtual bool     find(std::string)                         const;
-        virtual buffer_p load(std::string)                         const;
+        virtual bool     stamp(std::string, size_t *, unsigned long *) const;
+        virtual buffer_p load(std::string, bool)                   const;
         virtual bool     save(std::string, const void *, size_t *) const;
         virtual void     list(std::string, str_set&, str_set&)     const;
     };
@@ -23,8 +23,11 @@ namespace app
 
     class pack_buffer : public buffer
     {
+        bool borrowed;
+
     public:
-        pack_buffer(const void *);
+        pack_buffer(const void *, bool);
+       ~pack_buffer();
     };
 
     // Packaged data archive
@@ -36,7 +39,8 @@ namespace app
         pack_archive(const void *ptr, size_t len, int p=0);
 
         virtual bool     find(std::string)                         const;
-        virtual buffer_p load(std::string)                         const;
+        virtual bool     stamp(std::string, size_t *, unsigned long *) const;
+        virtual buffer_p load(std::string, bool)                   const;
         virtual bool     save(std::string, const void *, size_t *) const;
         virtual void     list(std::string, str_set&, str_set&)     const;
 
@@ -47,6 +51,20 @@ namespace app
 
         int         get_file_count() const;
         const void *get_file_first() const;
+
+        // Central directory index, hashed by normalized entry name
+
+        struct entry
+        {
+            std::string name;
+            const void *head;
+        };
+
+        std::vector<entry> entries;
+        std::vector<int>   index;
+
+        void        init_index();
+        const void *find_entry(const std::string&) const;
     };
 }
 
@@ -23,6 +23,8 @@
 #include <cstring>
 #include <errno.h>
 
+#include <SDL_mutex.h>
+
 #include <app-file.hpp>
 
 //-----------------------------------------------------------------------------
@@ -91,23 +93,46 @@ namespace app
     //-------------------------------------------------------------------------
     // Data buffer
 
+    // A buffer owns heap memory by default. Derived buffers may instead map
+    // or borrow their data, releasing it themselves and zeroing the pointer.
+    // A terminated buffer is followed by a NUL, as text parsers expect.
+
     class buffer
     {
     protected:
 
         unsigned char *ptr;
         size_t         len;
+        bool           term;
 
     public:
 
         buffer();
-       ~buffer();
+        virtual ~buffer();
 
         const void *get(size_t *) const;
+
+        size_t size()       const { return len;  }
+        bool   terminated() const { return term; }
     };
 
-    typedef buffer                         *buffer_p;
-    typedef std::map<std::string, buffer_p> buffer_m;
+    typedef buffer *buffer_p;
+
+    // Reference-counted buffer cache entry. Unreferenced entries are retained
+    // in least-recently-used order, within a budget, for prompt reloading. A
+    // stale entry was saved over while referenced, and reloads when next used.
+
+    struct buffer_ref
+    {
+        buffer_p buf;
+        int      ref;
+        bool     stale;
+
+        std::vector<buffer_p>            old;
+        std::list<std::string>::iterator lru;
+    };
+
+    typedef std::map<std::string, buffer_ref> buffer_m;
 
     //-------------------------------------------------------------------------
     // Data archive interface
@@ -119,7 +144,8 @@ namespace app
         archive(int p=0) : priority(p) { }
 
         virtual bool     find(std::string)                         const = 0;
-        virtual buffer_p load(std::string)                         const = 0;
+        virtual bool     stamp(std::string, size_t *, unsigned long *) const = 0;
+        virtual buffer_p load(std::string, bool)                   const = 0;
         virtual bool     save(std::string, const void *, size_t *) const = 0;
         virtual void     list(std::string, str_set&, str_set&)     const = 0;
 
@@ -152,9 +178,19 @@ namespace app
 
         std::string translate(const std::string&) const;
 
+        mutable std::map<std::string, std::string> translations;
+
         archive_l archives;
         buffer_m  buffers;
 
+        std::list<std::string> idle;
+        size_t                 idle_size;
+
+        SDL_mutex *mutex;
+
+        buffer_p load_buffer(const std::string&, bool);
+        void     trim(size_t);
+
     public:
 
         data(const std::string&);
@@ -165,9 +201,10 @@ namespace app
         void add_file_archive(const std::string&, bool, int=0);
         void add_pack_archive(const void *, size_t, int=50);
 
-        const void *load(const std::string&,               size_t * = 0);
+        const void *load(const std::string&,               size_t * = 0, bool = true);
         bool        save(const std::string&, const void *, size_t * = 0);
         bool        find(const std::string&);
+        bool        stamp(const std::string&, size_t *, unsigned long *);
         void        free(const std::string&);
         void        list(const std::string&, str_set&, str_set&) const;
     };
@@ -36,6 +36,8 @@
 #define DEFAULT_HORZ_FOV    60.00
 #define DEFAULT_VERT_FOV    35.00
 #define DEFAULT_PERF_AVERAGE 60
+#define DEFAULT_PERF_HISTORY 600
+#define DEFAULT_PERF_LATENCY 4
 
 //-----------------------------------------------------------------------------
 
@@ -14,6 +14,7 @@
 #define APP_EVENT_HPP
 
 #include <string>
+#include <vector>
 #include <cstring>
 #include <stdint.h>
 #include <errno.h>
@@ -24,6 +25,7 @@
 //-----------------------------------------------------------------------------
 
 #define DATAMAX 128
+#define POSEMAX   5
 
 // Event types
 
@@ -41,6 +43,7 @@
 #define E_START 11
 #define E_CLOSE 12
 #define E_FLUSH 13
+#define E_POSE  14
 
 //-----------------------------------------------------------------------------
 
@@ -93,12 +96,14 @@ namespace app
         double      get_real();
         bool        get_bool();
         int         get_byte();
+        int         get_half();
         int         get_word();
         long long   get_long();
 
         void        put_real(double);
         void        put_bool(bool);
         void        put_byte(int);
+        void        put_half(int);
         void        put_word(int);
         void        put_long(long long);
 
@@ -151,6 +156,14 @@ namespace app
         {
             int c;
         };
+        struct pose_data_t  // Quantized body poses, see wrl::world
+        {
+            int n;
+            int id[POSEMAX];
+            int p [POSEMAX][3];
+            int k [POSEMAX];
+            int q [POSEMAX][3];
+        };
 
         // Data union
 
@@ -163,6 +176,7 @@ namespace app
               user_data_t user;
               tick_data_t tick;
               text_data_t text;
+              pose_data_t pose;
         } data;
 
         void          put_type(unsigned char);
@@ -183,11 +197,12 @@ namespace app
         event *mk_start ();
         event *mk_close ();
         event *mk_flush ();
+        event *mk_pose  ();
 
-        // Network IO
+        // Network marshalling
 
-        event *send(SOCKET);
-        event *recv(SOCKET);
+        event *put(std::vector<char>&);
+        event *get(const std::vector<char>&, size_t&);
 
         std::string name();
     };
@@ -96,6 +96,7 @@ namespace app
         std::set<ogl::frame *> frame_set;
 
         void dump();
+        void poll();
 
     public:
 
@@ -109,7 +110,7 @@ namespace app
         const ogl::program *load_program(const std::string&);
         const ogl::texture *load_texture(const std::string&, const std::string&);
         const ogl::binding *load_binding(const std::string&, const std::string&);
-        const ogl::surface *load_surface(const std::string&, bool);
+        const ogl::surface *load_surface(const std::string&, bool, bool=false);
               ogl::convex  *load_convex (const std::string&);
 
               ogl::uniform *dupe_uniform(      ogl::uniform *);
@@ -136,9 +137,11 @@ namespace app
         void free_surface(const ogl::surface *);
         void free_convex (const ogl::convex  *);
 
+        void wait_surface(const ogl::surface *);
+
         // Anonymous GL state.
 
-        ogl::pool  *new_pool ();
+        ogl::pool  *new_pool (bool=false);
         ogl::image *new_image(GLsizei,
                               GLsizei,
                               GLenum=GL_TEXTURE_2D,
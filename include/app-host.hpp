@@ -105,9 +105,13 @@ namespace app
         void   fini_script();
         void   poll_script();
 
+        SOCKET init_connect(const std::string&, int, char);
+
         void   init_server(app::node);
         void   fini_server();
 
+        void   init_relay(app::node, const std::string&);
+
         void   init_client(app::node, const std::string&);
         void   fini_client();
         void   fork_client(const char *, const char *,
@@ -120,8 +124,32 @@ namespace app
 
         int      clients;
 
-        void send(event *);
-        void sync();
+        // The swap barrier has a channel of its own, apart from events.
+
+        SOCKET                   barrier_server_sd;
+        std::vector<SOCKET>      barrier_client_sd;
+        std::vector<std::string> barrier_client_name;
+        bool                     barrier_spin;
+        std::string              name;
+
+        // Relay tree configuration
+
+        int         fanout;
+        int         relay_port;
+        int         relay_children;
+        std::string parent_addr;
+        int         parent_port;
+
+        // Events are coalesced into length-prefixed frames.
+
+        std::vector<char> send_buf;
+        std::vector<char> recv_buf;
+        size_t            recv_pos;
+
+        void   send(event *);
+        void   flush();
+        event *recv(event *);
+        void   sync();
 
         // Event loops
 
@@ -14,6 +14,11 @@
 #define APP_PERF_HPP
 
 #include <map>
+#include <string>
+#include <vector>
+#include <cstdio>
+
+#include <SDL.h>
 
 #include <app-default.hpp>
 
@@ -27,9 +32,134 @@
 
 namespace app
 {
+    // Swap barrier telemetry. The host notes the arrival time of each client
+    // at the barrier, in milliseconds after this node reached it, and the time
+    // spent awaiting release by the server.  Skew is the latest arrival.
+
+    class perf_barrier
+    {
+    public:
+
+        perf_barrier();
+       ~perf_barrier();
+
+        void barrier_arrive(const std::string&, double);
+        void barrier_finish(double);
+
+        double             get_barrier_skew() const { return skew; }
+        double             get_barrier_wait() const { return wait; }
+        const std::string& get_barrier_late() const { return late; }
+
+    protected:
+
+        int         sum_frames;
+        double      sum_skew;
+        double      max_skew;
+        std::string max_late;
+
+        void barrier_reset();
+
+    private:
+
+        std::vector<std::string> name;
+        std::vector<double>      time;
+
+        double      skew;
+        double      wait;
+        std::string late;
+        FILE       *log;
+        int         barrier_frame;
+    };
+
+    // Hierarchical CPU and GPU section timing.  Sections nest, and each has a
+    // path of the names of its enclosing sections.  GPU times come from query
+    // timestamps harvested several frames late, so that reading them never
+    // stalls the pipeline.  A history of recent samples of each path gives
+    // percentiles, and each frame may be exported as CSV or Chrome trace.
+
+    class perf_timer
+    {
+    public:
+
+        perf_timer();
+       ~perf_timer();
+
+        void push(const char *);
+        void pop();
+
+        double get_cpu(const std::string&, double=0.5) const;
+        double get_gpu(const std::string&, double=0.5) const;
+
+    protected:
+
+        void frame();
+        void report() const;
+
+    private:
+
+        // A fixed-size ring of samples.
+
+        struct ring
+        {
+            std::vector<double> v;
+            size_t              n;
+
+            ring() : n(0) { }
+
+            void   put(double, size_t);
+            double get(double) const;
+        };
+
+        struct history
+        {
+            ring cpu;
+            ring gpu;
+        };
+
+        // A section in flight, and a frame of sections awaiting harvest.
+
+        struct section
+        {
+            const char  *name;
+            int          parent;
+            Uint64       cpu[2];
+            unsigned int gpu[2];
+        };
+
+        struct pending
+        {
+            int                       number;
+            std::vector<section>      sections;
+            std::vector<unsigned int> queries;
+            size_t                    used;
+
+            pending() : number(-1), used(0) { }
+        };
+
+        std::vector<pending> frames;
+        std::vector<int>     stack;
+        int                  current;
+        bool                 gpu;
+        size_t               limit;
+        bool                 verbose;
+
+        std::map<std::string, history> stats;
+
+        Uint64 epoch;
+        double gpu_offset;
+        bool   gpu_anchored;
+
+        FILE  *csv;
+        FILE  *trace;
+        bool   trace_first;
+
+        unsigned int query();
+        void         harvest(pending&);
+    };
+
 #ifdef NVPM //-----------------------------------------------------------------
 
-    class perf
+    class perf : public perf_barrier, public perf_timer
     {
         SDL_Window *window;
 
@@ -55,7 +185,7 @@ namespace app
 
 #else // not NVPM -------------------------------------------------------------
 
-    class perf
+    class perf : public perf_barrier, public perf_timer
     {
         SDL_Window *window;
 
@@ -82,4 +212,18 @@ extern app::perf *perf;
 
 //-----------------------------------------------------------------------------
 
+namespace app
+{
+    // Time the enclosing block as a perf section.
+
+    class perf_scope
+    {
+    public:
+        perf_scope(const char *name) { if (::perf) ::perf->push(name); }
+       ~perf_scope()                 { if (::perf) ::perf->pop();     }
+    };
+}
+
+//-----------------------------------------------------------------------------
+
 #endif
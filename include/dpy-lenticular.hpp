@@ -17,17 +17,11 @@
 
 #include <etc-vector.hpp>
 #include <dpy-display.hpp>
+#include <ogl-program.hpp>
 #include <app-file.hpp>
 
 //-----------------------------------------------------------------------------
 
-namespace ogl
-{
-    class program;
-}
-
-//-----------------------------------------------------------------------------
-
 namespace dpy
 {
     class lenticular : public display
@@ -90,6 +84,10 @@ namespace dpy
 
         const ogl::program *program;
 
+        // Uniform handles, shared and then per channel
+
+        std::vector<ogl::program::handle> uniforms;
+
         // Configuration state and event handlers
 
         app::node array;
@@ -0,0 +1,97 @@
+//  Copyright (C) 2014 Robert Kooima
+//
+//  THUMB is free software; you can redistribute it and/or modify it under
+//  the terms of  the GNU General Public License as  published by the Free
+//  Software  Foundation;  either version 2  of the  License,  or (at your
+//  option) any later version.
+//
+//  This program  is distributed in the  hope that it will  be useful, but
+//  WITHOUT   ANY  WARRANTY;   without  even   the  implied   warranty  of
+//  MERCHANTABILITY  or FITNESS  FOR A  PARTICULAR PURPOSE.   See  the GNU
+//  General Public License for more details.
+
+#ifndef ETC_TASK_HPP
+#define ETC_TASK_HPP
+
+#include <SDL_thread.h>
+#include <SDL_mutex.h>
+
+#include <vector>
+#include <deque>
+#include <utility>
+
+//-----------------------------------------------------------------------------
+
+namespace etc
+{
+    //-------------------------------------------------------------------------
+    // Unit of parallel work
+
+    class task
+    {
+    public:
+        virtual ~task() { }
+        virtual void run() = 0;
+    };
+
+    //-------------------------------------------------------------------------
+    // Group of tasks awaited together
+
+    class batch
+    {
+    public:
+        batch() : count(0) { }
+    private:
+        friend class worker_pool;
+        int count;
+    };
+
+    //-------------------------------------------------------------------------
+    // Fixed set of worker threads serving a shared task queue
+
+    // Tasks are not owned by the pool. The submitting thread joins the work
+    // when it waits, so a pool with no threads simply runs tasks serially.
+    // Tasks pushed with a batch may be awaited or polled apart from those of
+    // other threads sharing the pool.
+
+    class worker_pool
+    {
+    public:
+
+        worker_pool(int=0);
+       ~worker_pool();
+
+        void push(task *, batch * = 0);
+        void wait(batch * = 0);
+        void drop(batch *);
+        bool done(batch *);
+
+        int size() const { return int(threads.size()); }
+
+    private:
+
+        SDL_mutex *mutex;
+        SDL_cond  *wake;
+        SDL_cond  *idle;
+
+        typedef std::pair<task *, batch *> entry;
+
+        std::deque<entry> queue;
+
+        int  busy;
+        bool stop;
+
+        std::vector<SDL_Thread *> threads;
+
+        void finish(batch *);
+
+        static int loop(void *);
+    };
+}
+
+extern etc::worker_pool *workers;
+extern etc::worker_pool *loaders;
+
+//-----------------------------------------------------------------------------
+
+#endif
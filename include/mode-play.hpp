@@ -24,11 +24,14 @@ namespace mode
         bool process_start(app::event *);
         bool process_close(app::event *);
         bool process_tick(app::event *);
+        bool process_pose(app::event *);
 
     public:
 
         play(wrl::world *);
 
+        virtual ogl::aabb prep(int, const app::frustum *const *);
+
         virtual bool process_event(app::event *);
 
         virtual ~play();
@@ -62,6 +62,7 @@ namespace ogl
         bool depth_eq(const binding *) const;
         bool color_eq(const binding *) const;
         bool opaque() const;
+        bool indirect(bool) const;
 
         bool bind(bool) const;
 
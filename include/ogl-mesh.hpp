@@ -36,6 +36,21 @@ namespace ogl
 
     typedef std::vector<GLvec3> GLvec3_v;
 
+    // Interleaved, packed vertex. Normal and tangent are signed-normalized
+    // 10:10:10:2 and texture coordinates are half-float. The unit ID exceeds
+    // the exact integer range of a half, so it is split across p and q such
+    // that ID = p + (q - 1) * 2048. With planar data, q defaults to 1.
+
+    struct GLpack
+    {
+        GLfloat  v[3];
+        GLuint   n;
+        GLuint   t;
+        GLushort u[4];
+    };
+
+    typedef std::vector<GLpack> GLpack_v;
+
     // While contiguous buffers are required during rendering, there is no
     // continuity requirement for loader caches. So, there's a possibility
     // that a deque will outperform a vector during mesh loading. It turns
@@ -87,7 +102,7 @@ namespace ogl
     {
     public:
 
-        mesh(std::string&);
+        mesh(std::string&, bool=true);
         mesh();
        ~mesh();
 
@@ -100,6 +115,7 @@ namespace ogl
 
         void apply_offset(const double *);
         void calc_tangent();
+        void bind_material();
 
         void add_vert(GLvec3&, GLvec3&, GLvec3&);
         void add_face(GLuint, GLuint, GLuint);
@@ -115,6 +131,8 @@ namespace ogl
 
         const binding *state() const { return material; }
 
+        const std::string& get_name() const { return name; }
+
         GLsizei count_verts() const { return GLsizei(   vv.size()); }
         GLsizei count_faces() const { return GLsizei(faces.size()); }
         GLsizei count_lines() const { return GLsizei(lines.size()); }
@@ -127,10 +145,17 @@ namespace ogl
 
         void buffv(const GLfloat *, const GLfloat *,
                    const GLfloat *, const GLfloat *);
+        void buffp(const GLpack  *);
         void buffe(const GLuint  *);
 
+        // Binary cache readers and writers
+
+        size_t      write(void *) const;
+        const void *read (const void *, const void *);
+
     private:
 
+        std::string    name;
         const binding *material;
 
         // Vertex buffers
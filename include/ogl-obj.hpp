@@ -24,18 +24,38 @@ namespace obj
 {
     //-------------------------------------------------------------------------
 
-    struct iset
+    // An open-addressed table mapping index sets to mesh vertex indices.
+
+    class iset_table
     {
-        int vi;
-        int si;
-        int ni;
-        int ii;
+    public:
+
+        iset_table() : gen(1), used(0) { }
+
+        void clear();
+        int& find(int, int, int);
+
+    private:
 
-        iset(int v, int s, int n, int i) : vi(v), si(s), ni(n), ii(i) { }
+        struct iset
+        {
+            int vi;
+            int si;
+            int ni;
+            int  i;
+            unsigned int gen;
+        };
+
+        std::vector<iset> slots;
+        unsigned int      gen;
+        size_t            used;
+
+        void grow();
     };
 
-    typedef std::vector<int>  indx_v;
-    typedef std::vector<iset> iset_v;
+    class chunk;
+
+    typedef std::vector<chunk> chunk_v;
 
     //-------------------------------------------------------------------------
 
@@ -49,35 +69,35 @@ namespace obj
         ogl::GLvec3_d sv;
         ogl::GLvec3_d nv;
 
-        indx_v ii;
-        iset_v is;
+        iset_table fi;
+        iset_table li;
 
-        double scale;
+        std::vector<GLuint> iv;
 
-        // Read handlers.
+        bool lines;
+        bool bind;
 
-        const char *read_fi (const char *, int&);
-        const char *read_li (const char *, int&);
+        // Merge handlers.
 
-        const char *read_c  (const char *);
-        const char *read_use(const char *);
-        const char *read_f  (const char *);
-        const char *read_l  (const char *);
-        const char *read_v  (const char *);
-        const char *read_vt (const char *);
-        const char *read_vn (const char *);
+        const int *merge_use(const int *, const chunk&);
+        const int *merge_f  (const int *);
+        const int *merge_l  (const int *);
 
         void center();
 
     public:
 
-        obj(std::string, bool);
+        obj(std::string, bool, bool=true);
        ~obj();
 
         // Mesh accessors
 
         size_t           max_mesh()         const { return meshes.size(); }
         const ogl::mesh *get_mesh(size_t i) const { return meshes[i];     }
+
+        // Give ownership of all meshes to the caller.
+
+        void take_meshes(ogl::mesh_v& v) { v.swap(meshes); }
     };
 }
 
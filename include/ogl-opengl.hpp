@@ -21,6 +21,10 @@
 #define GL_TEXTURE_RECTANGLE GL_TEXTURE_RECTANGLE_ARB
 #endif
 
+// Storage buffer binding of node transforms, as declared in glsl/node.vert.
+
+#define NODE_TRANSFORM_BINDING 0
+
 namespace ogl
 {
     extern bool context;
@@ -29,6 +33,12 @@ namespace ogl
     extern bool has_multisample;
     extern bool has_anisotropic;
     extern bool has_s3tc;
+    extern bool has_rgtc;
+    extern bool has_bptc;
+    extern bool has_packed_verts;
+    extern bool has_pixel_buffer;
+    extern bool has_multi_draw;
+    extern bool has_timer_query;
 
     extern int  max_lights;
     extern int  max_anisotropy;
@@ -36,6 +46,7 @@ namespace ogl
     extern bool do_texture_compression;
     extern bool do_hdr_tonemap;
     extern bool do_hdr_bloom;
+    extern bool do_multi_draw;
 
     void check_err(const char *, int);
     bool check_ext(const char *);
@@ -45,9 +56,15 @@ namespace ogl
 
     void curr_texture(GLenum);
     void bind_texture(GLenum, GLenum, GLuint);
+    void dele_texture(GLuint);
     void xfrm_texture(GLenum, const GLdouble *);
     void free_texture();
 
+    void bind_program(GLuint);
+    void dele_program(GLuint);
+
+    void bind_transforms(GLuint);
+
     void line_state_init();
     void line_state_fini();
 }
@@ -41,6 +41,30 @@
 // and early-Z passes. Alpha-tested geometry is further distinguised, allowing
 // alpha-test geometry to be rendered last.
 
+// Buffer object storage is sub-allocated. Each unit holds a stable slice of
+// the vertex buffer and each node holds a growable slice of the element
+// buffer, so that adding, removing, or toggling a unit touches only the
+// storage of that unit and its node. Buffers grow geometrically and are
+// compacted lazily, once the live data falls well below their capacity.
+
+// A pool may optionally store its vertices interleaved and packed, as given by
+// ogl::GLpack, at 28 bytes per vertex rather than 48 in four planar arrays.
+// This requires packed normals to be unit length, and falls back on planar
+// arrays where packed vertex formats are not supported.
+
+// Surfaces may load in the background. Units of a loading surface occupy no
+// buffer space until it is ready, at which point the pool gives them their
+// meshes and reinserts them into their nodes.
+
+// Visibility is determined using a bounding volume hierarchy over the world-
+// space bounds of all nodes. It is refit as nodes move and rebuilt as nodes
+// come and go, and it tests any number of frusta in a single traversal.
+
+// Where multi-draw indirect rendering is supported, node transforms are also
+// stored in a shader storage buffer. Batches of programs that opt in to it are
+// then gathered from all visible nodes and issued with one multi-draw per
+// binding, rather than one draw per node and binding.
+
 //-----------------------------------------------------------------------------
 
 namespace ogl
@@ -54,10 +78,12 @@ namespace ogl
     typedef unit                      *unit_p;
     typedef std::set<unit_p>           unit_s;
     typedef std::set<unit_p>::iterator unit_i;
+    typedef std::vector<unit_p>        unit_v;
 
     typedef node                      *node_p;
     typedef std::set<node_p>           node_s;
     typedef std::set<node_p>::iterator node_i;
+    typedef std::vector<node_p>        node_v;
 
     typedef pool                      *pool_p;
     typedef std::set<pool_p>           pool_s;
@@ -65,6 +91,34 @@ namespace ogl
 
     typedef std::multimap<const mesh *, mesh_p, meshcmp> mesh_m;
 
+    //-------------------------------------------------------------------------
+    // Multi-draw indirect command, as given by ARB_multi_draw_indirect
+
+    struct draw_command
+    {
+        GLuint count;
+        GLuint instance_count;
+        GLuint first_index;
+        GLuint base_vertex;
+        GLuint base_instance;
+    };
+
+    // Queued multi-draw command, with the state it is drawn with
+
+    struct draw_item
+    {
+        const binding *bnd;
+        GLenum         typ;
+        draw_command   cmd;
+
+        bool operator<(const draw_item& that) const {
+            return (bnd < that.bnd) || (bnd == that.bnd && typ < that.typ);
+        }
+    };
+
+    typedef std::vector<draw_command> draw_command_v;
+    typedef std::vector<draw_item>    draw_item_v;
+
     //-------------------------------------------------------------------------
     // Drawable / mergable element batch
 
@@ -80,7 +134,10 @@ namespace ogl
         bool color_eq(const elem&) const;
         void merge   (const elem&);
 
-        void draw(bool) const;
+        void draw(bool, const binding *&) const;
+
+        bool      indirect(bool c) const { return bnd && bnd->indirect(c); }
+        draw_item item(GLuint)     const;
 
     private:
 
@@ -98,6 +155,82 @@ namespace ogl
     typedef std::vector<elem>                 elem_v;
     typedef std::vector<elem>::const_iterator elem_i;
 
+    //-------------------------------------------------------------------------
+    // Buffer object sub-allocator
+
+    class heap
+    {
+    public:
+
+        heap();
+
+        GLuint get(GLsizei);
+        void   put(GLuint, GLsizei);
+        void   clear();
+
+        bool sparse() const;
+
+        GLsizei size() const { return total; }
+        GLsizei used() const { return inuse; }
+
+    private:
+
+        typedef std::map<GLuint, GLsizei> block_m;
+
+        GLsizei total;
+        GLsizei inuse;
+        block_m blocks;
+
+        void grow(GLsizei);
+    };
+
+    //-------------------------------------------------------------------------
+    // Bounding volume hierarchy
+
+    class tree
+    {
+    public:
+
+        tree();
+
+        void build(const node_s&);
+        void move(node_p);
+        void refit();
+
+        ogl::aabb view(int, int, const vec4 *const *, int, aabb *);
+
+        bool is_stale() const { return stale > 4 * int(items.size()); }
+
+    private:
+
+        struct branch
+        {
+            aabb   bound;
+            int    parent;
+            int    l;
+            int    r;
+            node_p leaf;
+        };
+
+        struct item
+        {
+            node_p node;
+            aabb   bound;
+        };
+
+        typedef std::vector<item> item_v;
+
+        std::vector<branch> branches;
+        std::vector<int>    moved;
+
+        item_v items;
+        int    stale;
+
+        int  make(item_v::iterator, item_v::iterator, int);
+        void cull(int, int, int, const vec4 *const *, int,
+                  unsigned int, unsigned int, aabb *);
+    };
+
     //-------------------------------------------------------------------------
     // Static batchable
 
@@ -105,7 +238,7 @@ namespace ogl
     {
     public:
 
-        unit(std::string, bool=true);
+        unit(std::string, bool=true, bool=false);
         unit(const unit&);
        ~unit();
 
@@ -118,11 +251,27 @@ namespace ogl
 
         bool is_ubiq() const { return ubiquitous; }
 
+        // A unit whose surface is loading in the background has no meshes
+        // until it is ready, and must then be reset into its node.
+
+        bool is_loading() const { return !loaded; }
+        bool is_ready  () const { return loaded || surf->is_ready(); }
+        void set_ready ();
+        void wait      ();
+
+        node_p get_node() const { return my_node; }
+
         void transform(const mat4&, const mat4&);
 
         void merge_batch(mesh_m&);
 
-        void buff(bool);
+        void cache(bool);
+        void buff(GLfloat *, GLfloat *, GLfloat *, GLfloat *);
+        void buff(GLpack *);
+        void sort();
+
+        void   set_voff(GLuint);
+        GLuint get_voff() const { return vo; }
 
         GLsizei vcount() const { return vc; }
         GLsizei ecount() const { return ec; }
@@ -142,6 +291,7 @@ namespace ogl
 
         GLsizei vc;
         GLsizei ec;
+        GLuint  vo;
 
         node_p my_node;
         mesh_m my_mesh;
@@ -150,6 +300,7 @@ namespace ogl
         bool rebuff;
         bool active;
         bool ubiquitous;
+        bool loaded;
 
         const surface *surf;
 
@@ -175,15 +326,39 @@ namespace ogl
         void add_unit(unit_p);
         void rem_unit(unit_p);
 
+        void cache(unit_v&, bool);
         void buff(GLfloat *, GLfloat *, GLfloat *, GLfloat *, bool);
-        void sort(GLuint  *, GLuint);
+        void buff(GLpack *, bool);
+        void sort();
 
         ogl::aabb view(int, const vec4 *, int);
-        void      draw(int=0, bool=true, bool=false);
+        void      draw(int=0, bool=true, bool=false, draw_item_v * = 0);
+
+        bool test    (int, const vec4 *, int);
+        bool get_test(int) const;
+        void set_test(int, bool);
+        void set_test(int, int, bool);
+
+        void set_leaf(int i) { leaf = i; }
+        int  get_leaf() const { return leaf; }
+
+        void   set_slot(GLuint i) { slot = i; }
+        GLuint get_slot() const { return slot; }
+
+        void    set_eoff(GLuint, GLsizei);
+        GLuint  get_eoff() const { return eo; }
+        GLsizei get_ecap() const { return en; }
 
         GLsizei vcount() const { return vc; }
         GLsizei ecount() const { return ec; }
 
+        bool is_resort() const { return resort; }
+        bool is_ubiq  () const { return ubiquitous; }
+
+        aabb get_world_bound() const;
+
+        const unit_s& get_units() const { return my_unit; }
+
         void transform(const mat4&);
 
         mat4 get_world_transform() const;
@@ -194,17 +369,22 @@ namespace ogl
 
         GLsizei vc;
         GLsizei ec;
+        GLuint  eo;
+        GLsizei en;
+        int     leaf;
+        GLuint  slot;
 
         bool ubiquitous;
         bool rebuff;
+        bool resort;
 
         pool_p my_pool;
         unit_s my_unit;
         mesh_m my_mesh;
         aabb   my_aabb;
 
-        unsigned int test_cache;
-        unsigned int hint_cache;
+        std::vector<unsigned int>  test_cache;
+        std::vector<unsigned char> hint_cache;
 
         elem_v opaque_depth;
         elem_v opaque_color;
@@ -219,18 +399,24 @@ namespace ogl
     {
     public:
 
-        pool();
+        pool(bool=false);
        ~pool();
 
         void set_resort();
         void set_rebuff();
-        void add_vcount(GLsizei);
-        void add_ecount(GLsizei);
+        void set_moved(node_p);
+        void set_resort_all();
+
+        void alloc_unit(unit_p);
+        void free_unit (unit_p);
+        void alloc_node(node_p);
+        void free_node (node_p);
 
         void add_node(node_p);
         void rem_node(node_p);
 
         ogl::aabb view(int, const vec4 *, int);
+        ogl::aabb view(int, int, const vec4 *const *, int, aabb * = 0);
         void      prep();
 
         void draw_init();
@@ -242,19 +428,40 @@ namespace ogl
 
     private:
 
-        GLsizei vc;
-        GLsizei ec;
+        heap vert_heap;
+        heap elem_heap;
+
+        GLsizei vbo_size;
+        GLsizei ebo_size;
 
         bool resort;
         bool rebuff;
+        bool packed_opt;
+        bool packed;
+        bool rebuild;
+        bool restage;
 
         GLuint vbo;
         GLuint ebo;
+        GLuint xbo;
+        GLuint dbo;
+
+        std::vector<GLfloat> transforms;
+        draw_item_v          items;
+        draw_command_v       commands;
 
         node_s my_node;
+        unit_s loading;
+        tree   my_tree;
 
         void buff(bool);
         void sort();
+        void pack();
+
+        void stage();
+        void draw_items(bool);
+
+        GLsizei vsize() const;
     };
 }
 
@@ -14,6 +14,7 @@
 #define OGL_PROGRAM_HPP
 
 #include <string>
+#include <vector>
 #include <map>
 
 #include <etc-vector.hpp>
@@ -36,6 +37,26 @@ namespace ogl
     {
     public:
 
+        // A uniform handle names a uniform independent of any program.  Names
+        // are interned process-wide and each program resolves the locations of
+        // all of them when it links, so setting a uniform by handle costs one
+        // array index rather than a string copy and a driver query.
+
+        class handle
+        {
+        public:
+
+            explicit handle(const std::string&);
+
+            int get() const { return index; }
+
+            static const std::vector<std::string>& names();
+
+        private:
+
+            int index;
+        };
+
         const std::string& get_name() const { return name; }
 
         program(std::string);
@@ -50,7 +71,8 @@ namespace ogl
 
         GLenum unit(std::string) const;
 
-        bool discards() const { return discard; }
+        bool discards()    const { return discard;  }
+        bool is_indirect() const { return indirect; }
 
         void uniform(std::string, int)                     const;
         void uniform(std::string, double)                  const;
@@ -60,13 +82,31 @@ namespace ogl
         void uniform(std::string, const mat3&, bool=false) const;
         void uniform(std::string, const mat4&, bool=false) const;
 
+        void uniform(handle, int)                     const;
+        void uniform(handle, double)                  const;
+        void uniform(handle, const vec2&)             const;
+        void uniform(handle, const vec3&)             const;
+        void uniform(handle, const vec4&)             const;
+        void uniform(handle, const mat3&, bool=false) const;
+        void uniform(handle, const mat4&, bool=false) const;
+
         static const program *current;
 
     private:
 
         typedef std::map<      std::string,    GLenum> texture_map;
         typedef std::map<const ogl::process *, GLenum> process_map;
-        typedef std::map<      ogl::uniform *, GLint>  uniform_map;
+        // Each referenced uniform records the version last applied.
+
+        struct uniform_state
+        {
+            GLint                location;
+            mutable unsigned int version;
+
+            uniform_state(GLint l=-1) : location(l), version(0) { }
+        };
+
+        typedef std::map<      ogl::uniform *, uniform_state> uniform_map;
 
         std::string name;
 
@@ -78,8 +118,11 @@ namespace ogl
         process_map processes;
         uniform_map uniforms;
 
+        mutable std::vector<GLint> locations;
+
         bool bindable;
         bool discard;
+        bool indirect;
 
         bool program_log(GLhandleARB, const std::string&);
         bool  shader_log(GLhandleARB, const std::string&);
@@ -89,6 +132,9 @@ namespace ogl
 
         std::string load(const std::string&);
 
+        void  locate()         const;
+        GLint location(handle) const;
+
         void init_attributes(app::node);
         void init_textures  (app::node);
         void init_processes (app::node);
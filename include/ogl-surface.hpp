@@ -14,30 +14,67 @@
 #define OGL_SURFACE_HPP
 
 #include <string>
-#include <memory>
 
 #include <ogl-obj.hpp>
+#include <etc-task.hpp>
 
 //-----------------------------------------------------------------------------
 
 namespace ogl
 {
+    // A surface may be loaded on a background thread. Its meshes are parsed
+    // there without material bindings, and it presents no meshes until the
+    // render thread has polled it, bound its materials, and made it ready.
+
     class surface
     {
-        std::string             name;
-        std::auto_ptr<obj::obj> data;
+        std::string name;
+        mesh_v      meshes;
+        bool        center;
+        bool        cached;
+        bool        ready;
+
+        size_t        source_len;
+        unsigned long source_stamp;
+
+        std::string cache_name() const;
+
+        void load(bool);
+        bool load_cache(bool);
+
+        class loader : public etc::task
+        {
+            surface *s;
+        public:
+            loader(surface *s) : s(s) { }
+            void run();
+        };
+
+        loader     task;
+        etc::batch batch;
 
     public:
 
         const std::string& get_name() const { return name; }
 
-        surface(std::string name, bool center)
-            : name(name), data(new obj::obj(name, center)) { }
+        surface(std::string, bool, bool=false);
+       ~surface();
+
+        // Background loading
+
+        bool is_ready() const { return ready; }
+        bool poll();
+        void wait();
+
+        // Binary cache
+
+        bool is_cached() const { return cached; }
+        void save_cache() const;
 
         // Mesh accessors
 
-        size_t      max_mesh()         const { return data->max_mesh();  }
-        const mesh *get_mesh(size_t i) const { return data->get_mesh(i); }
+        size_t      max_mesh()         const { return ready ? meshes.size() : 0; }
+        const mesh *get_mesh(size_t i) const { return meshes[i]; }
     };
 }
 
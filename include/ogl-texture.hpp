@@ -19,11 +19,25 @@
 
 #include <etc-vector.hpp>
 #include <ogl-opengl.hpp>
+#include <etc-task.hpp>
 
 //-----------------------------------------------------------------------------
 
 namespace ogl
 {
+    class buffer;
+
+    // A texture may be given as a PNG image, from which mipmaps are generated,
+    // or as a DDS or KTX container of precompressed mipmaps. A PNG is passed
+    // over in favor of a compressed container of the same name, if present
+    // and supported. A top-down container whose blocks cannot be flipped, as
+    // with BC7, is used as stored and appears upside down.
+
+    // A texture given a proxy is decoded on the loader thread, and binds its
+    // proxy in its place until the render thread has uploaded all of its
+    // mipmap levels. Uploads are spread across frames within a byte budget.
+    // A texture that fails to decode binds its proxy for good.
+
     class texture
     {
         std::string name;
@@ -32,19 +46,57 @@ namespace ogl
         GLsizei w;
         GLsizei h;
         GLsizei c;
+        GLenum  compressed;
+
+        struct level
+        {
+            GLsizei w;
+            GLsizei h;
+            std::vector<GLubyte> p;
+        };
+
+        typedef std::pair<GLenum, GLint> param;
+
+        std::vector<level> levels;
+        std::vector<param> params;
+
+        const texture *proxy;
+        buffer        *pbo;
+        size_t         next;
+        bool           ready;
+        bool           failed;
 
         void load_png(const void *, size_t, std::vector<GLubyte>&);
         void load_jpg(const void *, size_t, std::vector<GLubyte>&); // TODO
+        bool load_dds(const void *, size_t);
+        bool load_ktx(const void *, size_t);
+        bool load_cmp(std::string);
+        void flip_levels(GLenum, GLsizei);
 
-        void load_img(std::string, std::map<int, vec4>&);
-        void load_opt(std::string, std::map<int, vec4>&);
+        void load_img(std::string, std::map<int, vec4>&, double);
+        void load_opt(std::string, std::map<int, vec4>&, double&);
         void load_prm(std::string);
 
+        void decode();
+        void upload(size_t);
+        void finish();
+
+        class loader : public etc::task
+        {
+            texture *t;
+        public:
+            loader(texture *t) : t(t) { }
+            void run();
+        };
+
+        loader     task;
+        etc::batch batch;
+
     public:
 
         const std::string& get_name() const { return name; }
 
-        texture(std::string);
+        texture(std::string, const texture * = 0);
        ~texture();
 
         void bind(GLenum=GL_TEXTURE0) const;
@@ -53,7 +105,15 @@ namespace ogl
         void init();
         void fini();
 
-        bool opaque() const { return (c == 1 || c == 3); }
+        // Background loading
+
+        bool           is_ready()  const { return ready;  }
+        bool           is_failed() const { return failed; }
+        const texture *get_proxy() const { return proxy; }
+
+        size_t poll(size_t);
+
+        bool opaque() const;
     };
 }
 
@@ -22,6 +22,9 @@
 
 namespace ogl
 {
+    // A uniform counts the changes to its value, allowing each program that
+    // references it to upload only those values changed since its last prep.
+
     class uniform
     {
     public:
@@ -31,6 +34,8 @@ namespace ogl
 
         const std::string& get_name() const { return name; }
 
+        unsigned int get_version() const { return version; }
+
         void set(double);
         void set(const vec2&);
         void set(const vec3&);
@@ -46,6 +51,10 @@ namespace ogl
 
         GLfloat *val;
         GLsizei  len;
+
+        unsigned int version;
+
+        void store(const GLfloat *, GLsizei);
     };
 }
 
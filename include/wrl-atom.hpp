@@ -59,6 +59,13 @@ namespace wrl
         ogl::unit *get_fill() { return fill; }
         ogl::unit *get_line() { return line; }
 
+        // Release and reload the GL state of an atom out of the scene
+
+        void stow();
+        void unstow();
+
+        size_t get_size() const;
+
         // Physics parameter accessors
 
         void set_param(int, std::string&);
@@ -115,6 +122,7 @@ namespace wrl
         ogl::unit  *line;
         std::string fill_name;
         std::string line_name;
+        bool        fill_ubiq;
 
         // Physical system parameters
 
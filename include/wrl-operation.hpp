@@ -40,6 +40,16 @@ namespace wrl
         virtual wrl::atom_set& undo(wrl::world *) = 0;
         virtual wrl::atom_set& redo(wrl::world *) = 0;
 
+        // Supersede a done modification of the same selection, in place.
+
+        virtual bool amend(wrl::world *, wrl::atom_set&, const mat4&) {
+            return false;
+        }
+
+        // Approximate the memory held by this operation.
+
+        virtual size_t size() const;
+
         virtual ~operation() { }
     };
 
@@ -59,6 +69,8 @@ namespace wrl
 
         wrl::atom_set& undo(wrl::world *);
         wrl::atom_set& redo(wrl::world *);
+
+        size_t size() const;
     };
 
     //-------------------------------------------------------------------------
@@ -73,6 +85,8 @@ namespace wrl
 
         wrl::atom_set& undo(wrl::world *);
         wrl::atom_set& redo(wrl::world *);
+
+        size_t size() const;
     };
 
     //-------------------------------------------------------------------------
@@ -89,6 +103,8 @@ namespace wrl
 
         wrl::atom_set& undo(wrl::world *);
         wrl::atom_set& redo(wrl::world *);
+
+        bool amend(wrl::world *, wrl::atom_set&, const mat4&);
     };
 
     //-------------------------------------------------------------------------
@@ -105,6 +121,8 @@ namespace wrl
 
         wrl::atom_set& undo(wrl::world *);
         wrl::atom_set& redo(wrl::world *);
+
+        size_t size() const;
     };
 
     //-------------------------------------------------------------------------
@@ -122,6 +140,8 @@ namespace wrl
 
         wrl::atom_set& undo(wrl::world *);
         wrl::atom_set& redo(wrl::world *);
+
+        size_t size() const;
     };
 }
 
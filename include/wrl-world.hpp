@@ -13,6 +13,13 @@
 #ifndef WRL_WORLD_HPP
 #define WRL_WORLD_HPP
 
+#include <SDL_thread.h>
+#include <SDL_mutex.h>
+
+#include <cstring>
+#include <vector>
+#include <map>
+
 #include <etc-vector.hpp>
 #include <etc-ode.hpp>
 #include <ogl-aabb.hpp>
@@ -23,6 +30,7 @@
 
 namespace app
 {
+    class event;
     class frustum;
 }
 
@@ -44,6 +52,9 @@ namespace wrl
     typedef std::map<int, dMass>       mass_map;
     typedef std::map<int, ogl::node *> node_map;
 
+    typedef std::pair<dGeomID, dGeomID> geom_pair;
+    typedef std::vector<geom_pair>      geom_pair_v;
+
     class world
     {
     public:
@@ -62,6 +73,8 @@ namespace wrl
         void edit_pick(const vec3&, const vec3&);
         void edit_step(double);
         void play_step(double);
+        void play_pose();
+        void play_recv(app::event *);
 
         dSpaceID get_space() const { return edit_space; }
         dGeomID  get_focus() const { return edit_focus; }
@@ -93,7 +106,7 @@ namespace wrl
         void do_enjoin();
         void do_embody();
         void do_debody();
-        void do_modify(const mat4&);
+        void do_modify(const mat4&, bool=false);
 
         void undo();
         void redo();
@@ -106,10 +119,9 @@ namespace wrl
 
         // Rendering methods
 
-        void set_light(int, const vec4&, int, app::frustum *);
+        void set_light(int, const vec4&, int, app::frustum *, const ogl::aabb&);
 
-        int s_light(int, const vec3&, const vec3&, double,
-                    int, const app::frustum *const *, const ogl::aabb&);
+        int s_light(int, const vec3&, const vec3&, double);
         int d_light(int, const vec3&, const vec3&, double,
                     int, const app::frustum *const *, const ogl::aabb&);
 
@@ -127,6 +139,9 @@ namespace wrl
         dSpaceID      edit_space;
         dGeomID       edit_point;
         dGeomID       edit_focus;
+        bool          edit_dirty;
+        vec3          edit_p;
+        vec3          edit_v;
 
         // ODE play state
 
@@ -137,6 +152,77 @@ namespace wrl
 
         body_map play_body;
 
+        // Collision candidates, gathered by the broad phase for a narrow phase
+        // run in parallel, and ODE's threaded stepper, if configured.
+
+        geom_pair_v                 play_pairs;
+        dThreadingImplementationID  play_threading;
+        dThreadingThreadPoolID      play_threads;
+        bool                        play_quick;
+
+        dSpaceID new_play_space();
+        void     play_collide();
+
+        // Simulation thread state.  While playing, the thread owns the ODE
+        // play state.  It steps at a fixed rate toward the time given by the
+        // ticks received, and publishes the body poses of its last two steps.
+
+        struct pose
+        {
+            vec3 p;
+            quat q;
+        };
+
+        // A pose quantized for replication: position in fixed point, and the
+        // three smallest quaternion components with the index of the largest.
+
+        struct quant
+        {
+            int p[3];
+            int k;
+            int q[3];
+
+            bool operator!=(const quant& that) const {
+                return memcmp(this, &that, sizeof (quant)) != 0;
+            }
+        };
+
+        SDL_Thread *sim_thread;
+        SDL_mutex  *sim_mutex;
+        SDL_cond   *sim_cond;
+        bool        sim_stop;
+        double      sim_step;
+        double      sim_goal;
+        int         sim_count;
+
+        std::vector<ogl::node *> sim_node;
+        std::vector<dBodyID>     sim_body;
+        std::vector<pose>        sim_prev;
+        std::vector<pose>        sim_curr;
+
+        // Replication state.  With physics_replicate, only the root simulates.
+        // Once per frame it sends the bodies whose quantized poses have
+        // changed, and clients apply them in place of simulating.
+
+        bool                     sim_replicate;
+        bool                     sim_remote;
+        std::vector<int>         sim_id;
+        std::vector<quant>       sim_sent;
+        std::vector<size_t>      sim_pend;
+        std::map<int, int>       sim_index;
+
+        void play_tick();
+        void play_publish();
+        void play_send();
+
+        double sim_alpha(bool);
+        pose   sim_lerp(size_t, double) const;
+
+        static quant encode(const pose&);
+        static mat4  decode(const quant&);
+
+        static int sim_loop(void *);
+
         // World state
 
         atom_set all;
@@ -160,8 +246,11 @@ namespace wrl
 
         wrl::operation_l undo_list;
         wrl::operation_l redo_list;
+        size_t           undo_limit;
+        size_t           undo_memory;
 
         void doop(wrl::operation_p);
+        void trim();
 
         // Lighting uniforms and processes
 
@@ -177,6 +266,13 @@ namespace wrl
 
         ogl::process *process_shadow[4];
         ogl::process *process_cookie[4];
+
+        // Shadow frusta, culled together before their maps are rendered
+
+        app::frustum *shadow_frustum [4];
+        vec4          shadow_position[4];
+
+        ogl::aabb     fill_bound;
     };
 }
 
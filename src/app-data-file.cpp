@@ -19,6 +19,7 @@
 #include <io.h>
 #else
 #include <unistd.h>
+#include <sys/mman.h>
 #endif
 
 #include <app-default.hpp>
@@ -28,7 +29,11 @@
 
 //-----------------------------------------------------------------------------
 
-app::file_buffer::file_buffer(std::string name)
+// Files smaller than this are read rather than mapped.
+
+#define MIN_MAP_SIZE (64 * 1024)
+
+app::file_buffer::file_buffer(std::string name) : mapped(false)
 {
     struct stat info;
     int fd;
@@ -44,23 +49,60 @@ app::file_buffer::file_buffer(std::string name)
 #endif
 
     if (fstat(fd, &info) != 0)
+    {
+        close(fd);
         throw stat_error(name);
-
-    // Initialize the buffer.
+    }
 
     len = (size_t) info.st_size;
-    ptr = new unsigned char[len + 1];
 
-    memset(ptr, 0, len + 1);
+#ifndef _WIN32
 
-    // Read all data.
+    // Map large files.  The remainder of the last page reads as zero, giving
+    // the NUL sentinel, unless the file exactly fills its last page.
+
+    const size_t page = (size_t) sysconf(_SC_PAGESIZE);
+
+    if (len >= MIN_MAP_SIZE && len % page)
+    {
+        void *p = mmap(0, len, PROT_READ, MAP_PRIVATE, fd, 0);
+
+        if (p != MAP_FAILED)
+        {
+            ptr    = (unsigned char *) p;
+            mapped = true;
+
+            close(fd);
+            return;
+        }
+    }
+#endif
+
+    // Otherwise read all data into a terminated heap buffer.
+
+    ptr = new unsigned char[len + 1];
+    ptr[len] = 0;
 
     if (read(fd, ptr, len) < (int) len)
+    {
+        close(fd);
         throw read_error(name);
+    }
 
     close(fd);
 }
 
+app::file_buffer::~file_buffer()
+{
+#ifndef _WIN32
+    if (mapped)
+    {
+        munmap(ptr, len);
+        ptr = 0;
+    }
+#endif
+}
+
 //-----------------------------------------------------------------------------
 
 app::file_archive::file_archive(std::string path, bool writable, int prio)
@@ -82,9 +124,27 @@ bool app::file_archive::find(std::string name) const
         return false;
 }
 
+// Give the size and modification time of the named file.
+
+bool app::file_archive::stamp(std::string name, size_t *len, unsigned long *s) const
+{
+    std::string curr = pathname(path, name);
+
+    struct stat info;
+
+    if (stat(curr.c_str(), &info) == 0 && (info.st_mode & S_IFMT) == S_IFREG)
+    {
+        if (len) *len = (size_t) info.st_size;
+        if (s)   *s   = (unsigned long) info.st_mtime;
+        return true;
+    }
+    else
+        return false;
+}
+
 // Return a buffer containing the named data file.
 
-app::buffer_p app::file_archive::load(std::string name) const
+app::buffer_p app::file_archive::load(std::string name, bool text) const
 {
     return new file_buffer(pathname(path, name));
 }
@@ -110,18 +170,33 @@ bool app::file_archive::save(std::string name,
             size_t count = len ? (*len) : strlen((const char *) ptr);
             int fd;
 
-            // Open the named file for writing.
+            // Write to a temporary and rename it over the named file, leaving
+            // any live mapping of the old contents intact.
+
+#ifndef _WIN32
+            std::string temp = curr + "~";
+#else
+            std::string temp = curr;
+#endif
+            // Open the file for writing.
 
-            if ((fd = open(curr.c_str(), O_WRONLY | O_TRUNC | O_CREAT, 0666)) == -1)
+            if ((fd = open(temp.c_str(), O_WRONLY | O_TRUNC | O_CREAT, 0666)) == -1)
                 throw open_error(name);
 
             // Write all data.
 
             if (write(fd, ptr, count) < (int) count)
+            {
+                close(fd);
                 throw write_error(name);
+            }
 
             close(fd);
 
+#ifndef _WIN32
+            if (rename(temp.c_str(), curr.c_str()) != 0)
+                throw write_error(name);
+#endif
             return true;
         }
     }
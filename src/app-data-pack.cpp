@@ -161,7 +161,7 @@ void zfree(void *opaque, void *address)
     free(address);
 }
 
-app::pack_buffer::pack_buffer(const void *p)
+app::pack_buffer::pack_buffer(const void *p, bool text) : borrowed(false)
 {
     const local_file_header *h = (const local_file_header *) p;
 
@@ -171,9 +171,19 @@ app::pack_buffer::pack_buffer(const void *p)
                                                     + h->sizeof_extra;
 
         len = h->sizeof_uncompressed;
-        ptr = new unsigned char[len + 1];
 
-        memset(ptr, 0, len + 1);
+        // Share stored data in place unless a NUL sentinel is needed.
+
+        if (h->compression == 0 && !text)
+        {
+            ptr      = (unsigned char *) dat;
+            term     = false;
+            borrowed = true;
+            return;
+        }
+
+        ptr = new unsigned char[len + 1];
+        ptr[len] = 0;
 
         if (h->sizeof_uncompressed == h->sizeof_compressed)
             memcpy(ptr, dat, len);
@@ -209,38 +219,117 @@ app::pack_buffer::pack_buffer(const void *p)
     else throw read_error("Corrupt ZIP");
 }
 
+app::pack_buffer::~pack_buffer()
+{
+    if (borrowed) ptr = 0;
+}
+
 //-----------------------------------------------------------------------------
 
 app::pack_archive::pack_archive(const void *ptr, size_t len, int p)
     : archive(p), ptr(ptr), len(len)
 {
+    init_index();
 }
 
-// Determine whether the named file exists within this archive.
+//-----------------------------------------------------------------------------
 
-bool app::pack_archive::find(std::string name) const
+// FNV-1a string hash.
+
+static size_t hash(const std::string& s)
+{
+    unsigned int h = 2166136261u;
+
+    for (std::string::const_iterator i = s.begin(); i != s.end(); ++i)
+        h = (h ^ (unsigned char) (*i)) * 16777619u;
+
+    return size_t(h);
+}
+
+// Walk the central directory once, noting each entry under its normalized
+// name in an open-addressed hash table.
+
+void app::pack_archive::init_index()
 {
     int n = get_file_count();
 
     for (const void *p = get_file_first(); p && n; p = get_file_next(p), n--)
-        if (get_file_name(p) == fixpath(name))
-            return true;
+    {
+        entry e;
+
+        e.name = get_file_name(p);
+        e.head = p;
+
+        entries.push_back(e);
+    }
+
+    // Size the table to a power of two at least twice the entry count.
+
+    size_t m = 16;
+
+    while (m < entries.size() * 2)
+        m *= 2;
+
+    index.assign(m, -1);
+
+    // Insert each entry.  The first of any duplicate names wins, as before.
+
+    for (size_t i = 0; i < entries.size(); ++i)
+    {
+        size_t k = hash(entries[i].name) & (m - 1);
+
+        while (index[k] >= 0 && entries[index[k]].name != entries[i].name)
+            k = (k + 1) & (m - 1);
 
+        if (index[k] < 0)
+            index[k] = int(i);
+    }
+}
+
+// Return the central directory header of the named entry, or null.
+
+const void *app::pack_archive::find_entry(const std::string& name) const
+{
+    if (!index.empty())
+    {
+        const std::string path = fixpath(name);
+        const size_t      m    = index.size();
+
+        for (size_t k = hash(path) & (m - 1); index[k] >= 0; k = (k + 1) & (m - 1))
+            if (entries[index[k]].name == path)
+                return entries[index[k]].head;
+    }
+    return 0;
+}
+
+//-----------------------------------------------------------------------------
+
+// Determine whether the named file exists within this archive.
+
+bool app::pack_archive::find(std::string name) const
+{
+    return (find_entry(name) != 0);
+}
+
+// Give the size and CRC of the named file.
+
+bool app::pack_archive::stamp(std::string name, size_t *len, unsigned long *s) const
+{
+    if (const file_header *f = (const file_header *) find_entry(name))
+    {
+        if (len) *len = (size_t) f->sizeof_uncompressed;
+        if (s)   *s   = (unsigned long) f->crc;
+        return true;
+    }
     return false;
 }
 
 // Return a buffer containing the named data file.
 
-app::buffer_p app::pack_archive::load(std::string name) const
+app::buffer_p app::pack_archive::load(std::string name, bool text) const
 {
-    int n = get_file_count();
-
-    for (const void *p = get_file_first(); p && n; p = get_file_next(p), n--)
-        if (get_file_name(p) == fixpath(name))
-        {
-            const file_header *f = (const file_header *) p;
-            return new pack_buffer((const char *) ptr + f->offset);
-        }
+    if (const file_header *f = (const file_header *) find_entry(name))
+        return new pack_buffer((const char *) ptr + f->offset, text);
 
     return 0;
 }
@@ -260,13 +349,11 @@ void app::pack_archive::list(std::string dirname, str_set& dirs,
 {
     const std::string path = dirname.empty() ? dirname : dirname + PATH_SEPARATOR;
 
-    int n = get_file_count();
-
-    for (const void *p = get_file_first(); p && n; p = get_file_next(p), n--)
+    for (std::vector<entry>::const_iterator i = entries.begin(); i != entries.end(); ++i)
     {
         // If the path matches, add the name to the file or directory list.
 
-        const std::string pathname = get_file_name(p);
+        const std::string& pathname = i->name;
 
         if (pathname.compare(0, path.size(), path) == 0)
         {
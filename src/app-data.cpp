@@ -29,7 +29,23 @@
 
 //-----------------------------------------------------------------------------
 
-app::buffer::buffer() : ptr(0), len(0)
+// Hold the data mutex for the duration of a scope. Assets may be loaded on
+// background threads, so every public entry point takes it.
+
+namespace
+{
+    class lock
+    {
+        SDL_mutex *m;
+    public:
+        lock(SDL_mutex *m) : m(m) { SDL_LockMutex  (m); }
+       ~lock()                   { SDL_UnlockMutex(m); }
+    };
+}
+
+//-----------------------------------------------------------------------------
+
+app::buffer::buffer() : ptr(0), len(0), term(true)
 {
 }
 
@@ -54,6 +70,15 @@ std::string app::data::translate(const std::string& filename) const
 {
     if (::conf && file.get_root())
     {
+        // Return any prior translation of the named file.
+
+        std::map<std::string, std::string>::const_iterator i;
+
+        if ((i = translations.find(filename)) != translations.end())
+            return i->second;
+
+        std::string& target = translations[filename] = filename;
+
         // Locate the list of options for the named file.
 
         if (app::node n = file.get_root().find("file", "name", filename))
@@ -62,15 +87,16 @@ std::string app::data::translate(const std::string& filename) const
 
             for (app::node c = n.find("option"); c; c = n.next(c, "option"))
             {
-                // If the option matches the config setting, return the target.
+                // If the option matches the config setting, note the target.
 
                 const std::string name  = c.get_s("name");
                 const std::string value = c.get_s("value");
 
                 if (::conf->get_s(name) == value)
-                    return c.get_s();
+                    return (target = c.get_s());
             }
         }
+        return target;
     }
 
     // No configured option was found.  Return the original string.
@@ -83,7 +109,8 @@ std::string app::data::translate(const std::string& filename) const
 extern unsigned char thumb_data[];
 extern unsigned int  thumb_data_len;
 
-app::data::data(const std::string& filename) : filename(filename), file("")
+app::data::data(const std::string& filename) :
+    filename(filename), file(""), idle_size(0), mutex(SDL_CreateMutex())
 {
     int rwprio = 10;
     int roprio = 30;
@@ -132,22 +159,40 @@ app::data::data(const std::string& filename) : filename(filename), file("")
 
 app::data::~data()
 {
+    for (buffer_m::iterator i = buffers.begin(); i != buffers.end(); ++i)
+    {
+        for (std::vector<buffer_p>::iterator j = i->second.old.begin();
+                                             j != i->second.old.end(); ++j)
+            delete *j;
+
+        delete i->second.buf;
+    }
+
     for (archive_i i = archives.begin(); i != archives.end(); ++i)
         delete *i;
+
+    SDL_DestroyMutex(mutex);
 }
 
 // The database is a chicken and its configuration is an egg.
 
 void app::data::init()
 {
+    lock l(mutex);
+
     if (file.get_root() == 0)
+    {
         file = app::file(filename);
+        translations.clear();
+    }
 }
 
 // Add an additional filesystem path.
 
 void app::data::add_file_archive(const std::string& path, bool rw, int prio)
 {
+    lock l(mutex);
+
     archives.insert(new app::file_archive(path, rw, prio));
 }
 
@@ -155,53 +200,109 @@ void app::data::add_file_archive(const std::string& path, bool rw, int prio)
 
 void app::data::add_pack_archive(const void *ptr, size_t len, int prio)
 {
+    lock l(mutex);
+
     archives.insert(new app::pack_archive(ptr, len, prio));
 }
 
-// Return a buffer containing the named data file.
+// Search the list of archives for the first one with the named buffer.
 
-const void *app::data::load(const std::string& name, size_t *len)
+app::buffer_p app::data::load_buffer(const std::string& name, bool text)
 {
-    // If the named buffer has not yet been loaded, load it.
+    const std::string rename = translate(name);
 
-    if (buffers.find(name) == buffers.end())
+    for (archive_c i = archives.begin(); i != archives.end(); ++i)
+        if ((*i)->find(rename))
+            return (*i)->load(rename, text);
+
+    throw find_error(name);
+}
+
+// Return a buffer containing the named data file. A text buffer is followed
+// by a NUL. A binary buffer may not be, allowing it to be shared in place.
+
+const void *app::data::load(const std::string& name, size_t *len, bool text)
+{
+    lock l(mutex);
+
+    buffer_m::iterator i = buffers.find(name);
+
+    if (i == buffers.end())
+    {
+        // The named buffer has not yet been loaded.  Load it.
+
+        buffer_ref r;
+
+        r.buf   = load_buffer(name, text);
+        r.ref   = 1;
+        r.stale = false;
+        r.lru   = idle.end();
+
+        i = buffers.insert(buffer_m::value_type(name, r)).first;
+    }
+    else
     {
-        // Search the list of archives for the first one with the named buffer.
+        // If the buffer was saved over, or if text is needed but not given,
+        // retire the buffer and reload. Any prior users of the retired buffer
+        // may continue to use it.
 
-        for (archive_c i = archives.begin(); i != archives.end(); ++i)
+        if (i->second.stale || (text && !i->second.buf->terminated()))
         {
-            const std::string rename = translate(name);
+            buffer_p b = load_buffer(name, text);
 
-            if ((*i)->find(rename))
+            if (i->second.ref)
+                i->second.old.push_back(i->second.buf);
+            else
             {
-                buffers[name] = (*i)->load(rename);
-                break;
+                idle_size -= i->second.buf->size();
+                idle_size += b->size();
+                delete i->second.buf;
             }
+            i->second.buf   = b;
+            i->second.stale = false;
         }
-    }
 
-    // Return the named buffer.
+        // Take a reference to the loaded buffer, reclaiming it if idle.
 
-    if (buffers.find(name) != buffers.end())
-        return buffers[name]->get(len);
-    else
-    {
-        throw find_error(name);
-        return 0;
+        if (i->second.ref++ == 0)
+        {
+            idle_size -= i->second.buf->size();
+            idle.erase(i->second.lru);
+            i->second.lru = idle.end();
+        }
     }
+
+    return i->second.buf->get(len);
 }
 
 // Scan the archives for the first one containing the named buffer.
 
 bool app::data::find(const std::string& name)
 {
-    for (archive_c i = archives.begin(); i != archives.end(); ++i)
-    {
-        const std::string rename = translate(name);
+    lock l(mutex);
 
+    const std::string rename = translate(name);
+
+    for (archive_c i = archives.begin(); i != archives.end(); ++i)
         if ((*i)->find(rename))
             return true;
-    }
+
+    return false;
+}
+
+// Find the size and version stamp of the named buffer. The stamp changes when
+// the content does, allowing derived data to be cached and validated.
+
+bool app::data::stamp(const std::string& name, size_t *len, unsigned long *s)
+{
+    lock l(mutex);
+
+    const std::string rename = translate(name);
+
+    for (archive_c i = archives.begin(); i != archives.end(); ++i)
+        if ((*i)->stamp(rename, len, s))
+            return true;
+
     return false;
 }
 
@@ -209,6 +310,27 @@ bool app::data::find(const std::string& name)
 
 bool app::data::save(const std::string& name, const void *ptr, size_t *len)
 {
+    lock l(mutex);
+
+    // Invalidate any cached copy of the old contents. An idle buffer, which
+    // may map the file, is deleted. A referenced one is reloaded when next
+    // used, and its current users retain it.
+
+    buffer_m::iterator i = buffers.find(name);
+
+    if (i != buffers.end())
+    {
+        if (i->second.ref == 0)
+        {
+            idle_size -= i->second.buf->size();
+            idle.erase(i->second.lru);
+
+            delete i->second.buf;
+            buffers.erase(i);
+        }
+        else i->second.stale = true;
+    }
+
     for (archive_c i = archives.begin(); i != archives.end(); ++i)
         if ((*i)->save(name, ptr, len))
             return true;
@@ -221,18 +343,50 @@ bool app::data::save(const std::string& name, const void *ptr, size_t *len)
 void app::data::list(const std::string& name, str_set& dirs,
                                               str_set& regs) const
 {
+    lock l(mutex);
+
     for (archive_c i = archives.begin(); i != archives.end(); ++i)
         (*i)->list(name, dirs, regs);
 }
 
-// If the named buffer has been loaded, free it.
+// Release a reference to the named buffer. Retain it until the total size of
+// all unreferenced buffers exceeds the configured budget.
 
 void app::data::free(const std::string& name)
 {
-    if (buffers.find(name) != buffers.end())
+    lock l(mutex);
+
+    buffer_m::iterator i = buffers.find(name);
+
+    if (i != buffers.end() && i->second.ref > 0 && --i->second.ref == 0)
+    {
+        for (std::vector<buffer_p>::iterator j = i->second.old.begin();
+                                             j != i->second.old.end(); ++j)
+            delete *j;
+
+        i->second.old.clear();
+
+        i->second.lru = idle.insert(idle.end(), name);
+        idle_size    += i->second.buf->size();
+
+        trim(::conf ? size_t(::conf->get_i("data_cache_size", 32)) << 20
+                    : size_t(32) << 20);
+    }
+}
+
+// Delete the least-recently-used unreferenced buffers until within budget.
+
+void app::data::trim(size_t budget)
+{
+    while (idle_size > budget && !idle.empty())
     {
-        delete buffers[name];
-        buffers.erase(name);
+        buffer_m::iterator i = buffers.find(idle.front());
+
+        idle_size -= i->second.buf->size();
+        idle.pop_front();
+
+        delete i->second.buf;
+        buffers.erase(i);
     }
 }
 
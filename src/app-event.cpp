@@ -81,6 +81,27 @@ int app::event::get_byte()
 
 //-----------------------------------------------------------------------------
 
+// Append a 16-bit int to the payload data.
+
+void app::event::put_half(int i)
+{
+    int16_t h = int16_t(i);
+    memcpy(payload.data + payload.size, &h, sizeof (int16_t));
+    payload.size += sizeof (int16_t);
+}
+
+// Return the next 16-bit int in the payload data.
+
+int app::event::get_half()
+{
+    int16_t h;
+    memcpy(&h, payload.data + payload_index, sizeof (int16_t));
+    payload_index += sizeof (int16_t);
+    return int(h);
+}
+
+//-----------------------------------------------------------------------------
+
 // Append an int to the payload data.
 
 void app::event::put_word(int i)
@@ -184,6 +205,23 @@ void app::event::payload_encode()
 
         put_word(data.text.c);
         break;
+
+    case E_POSE:
+
+        put_byte(data.pose.n);
+
+        for (int i = 0; i < data.pose.n; ++i)
+        {
+            put_word(data.pose.id[i]);
+            put_word(data.pose.p [i][0]);
+            put_word(data.pose.p [i][1]);
+            put_word(data.pose.p [i][2]);
+            put_byte(data.pose.k [i]);
+            put_half(data.pose.q [i][0]);
+            put_half(data.pose.q [i][1]);
+            put_half(data.pose.q [i][2]);
+        }
+        break;
     }
 }
 
@@ -250,6 +288,23 @@ void app::event::payload_decode()
 
         data.text.c = get_word();
         break;
+
+    case E_POSE:
+
+        data.pose.n = get_byte();
+
+        for (int i = 0; i < data.pose.n; ++i)
+        {
+            data.pose.id[i]    = get_word();
+            data.pose.p [i][0] = get_word();
+            data.pose.p [i][1] = get_word();
+            data.pose.p [i][2] = get_word();
+            data.pose.k [i]    = get_byte();
+            data.pose.q [i][0] = get_half();
+            data.pose.q [i][1] = get_half();
+            data.pose.q [i][2] = get_half();
+        }
+        break;
     }
 }
 
@@ -408,45 +463,67 @@ app::event *app::event::mk_flush()
     return this;
 }
 
-//-----------------------------------------------------------------------------
+// Begin an empty pose event.  The caller fills in to POSEMAX poses.
 
-app::event *app::event::recv(SOCKET s)
+app::event *app::event::mk_pose()
 {
-    // Null any existing payload.
+    put_type(E_POSE);
 
-    put_type(E_NULL);
+    data.pose.n = 0;
 
-    // Block until receipt of the payload head and data.
+    payload_cache = false;
+    return this;
+}
 
-    if (::recv(s, (char *) &payload, 2, 0) == -1)
-        throw app::sock_error("recv");
+//-----------------------------------------------------------------------------
 
-    // TODO: repeat until payload size is received.
+// Append the encoded event to the given buffer.
 
-    memset(payload.data, 0, DATAMAX);
+app::event *app::event::put(std::vector<char>& buf)
+{
+    // Encode the payload, if necessary.
+
+    if (payload_cache == false)
+        payload_encode();
 
-    if (payload.size > 0)
-        if (::recv(s,  payload.data, payload.size, 0) == -1)
-            throw app::sock_error("recv");
+    // Append the payload head and data.
 
-    // Decode the payload.
+    const char *p = (const char *) &payload;
 
-    payload_decode();
+    buf.insert(buf.end(), p, p + payload.size + 2);
 
     return this;
 }
 
-app::event *app::event::send(SOCKET s)
+// Decode the event at position I of the given buffer and advance I past it.
+
+app::event *app::event::get(const std::vector<char>& buf, size_t& i)
 {
-    // Encode the payload, if necessary.
+    // Null any existing payload.
 
-    if (payload_cache == false)
-        payload_encode();
+    put_type(E_NULL);
+
+    if (i + 2 > buf.size())
+        throw std::runtime_error("Truncated event");
+
+    // Copy the payload head and data.
 
-    // Send the payload on the given socket.
+    payload.type = (unsigned char) buf[i + 0];
+    payload.size = (unsigned char) buf[i + 1];
+
+    if (i + 2 + payload.size > buf.size())
+        throw std::runtime_error("Truncated event");
+
+    memset(payload.data, 0, DATAMAX);
 
-    if (::send(s, (const char *) &payload, payload.size + 2, 0) == -1)
-        throw app::sock_error("send");
+    if (payload.size)
+        memcpy(payload.data, &buf[i + 2], payload.size);
+
+    i += payload.size + 2;
+
+    // Decode the payload.
+
+    payload_decode();
 
     return this;
 }
@@ -469,6 +546,7 @@ std::string app::event::name()
         case E_START:  return "START";
         case E_CLOSE:  return "CLOSE";
         case E_FLUSH:  return "FLUSH";
+        case E_POSE:   return "POSE";
         default:       return "UNKNOWN";
     }
 }
@@ -170,7 +170,7 @@ void app::text::set(const GLubyte *p)
 app::font::font(std::string filename, int size) : filename(filename), s(size)
 {
     size_t     len;
-    const void *ptr = ::data->load(filename, &len);
+    const void *ptr = ::data->load(filename, &len, false);
 
     // Initialize the font library and font face.
 
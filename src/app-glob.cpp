@@ -11,9 +11,11 @@
 //  General Public License for more details.
 
 #include <stdexcept>
+#include <algorithm>
 #include <sstream>
 #include <cassert>
 #include <cstdio>
+#include <vector>
 
 #include <ogl-reflection-env.hpp>
 #include <ogl-irradiance-env.hpp>
@@ -35,6 +37,8 @@
 #include <ogl-pool.hpp>
 
 #include <app-glob.hpp>
+#include <app-conf.hpp>
+#include <etc-task.hpp>
 
 // TODO: Template some of this repetition?
 
@@ -329,17 +333,28 @@ const ogl::texture *app::glob::load_texture(const std::string& name,
 {
     if (texture_map.find(name) == texture_map.end())
     {
+        // When loading in the background, the fallback stands in meanwhile.
+
+        const ogl::texture *proxy = 0;
+
+        if (::loaders && name != fallback)
+            proxy = load_texture(fallback, fallback);
+
         try
         {
-            if (ogl::texture *p = new ogl::texture(name))
+            if (ogl::texture *p = new ogl::texture(name, proxy))
             {
                 texture_map[name].ptr = p;
                 texture_map[name].ref = 1;
+
+                if (p->is_ready()) free_texture(proxy);
             }
         }
         catch (std::runtime_error&)
         {
-            if (name == fallback)
+            if (proxy)
+                return proxy;
+            else if (name == fallback)
                 return 0;
             else
                 return load_texture(fallback, fallback);
@@ -373,8 +388,16 @@ void app::glob::free_texture(const std::string& name)
     {
         if (--i->second.ref == 0)
         {
-            delete i->second.ptr;
+            ogl::texture *p = i->second.ptr;
+
             texture_map.erase(i);
+
+            // A texture still loading holds a reference to its proxy.
+
+            const ogl::texture *q = p->is_ready() ? 0 : p->get_proxy();
+
+            delete p;
+            free_texture(q);
         }
     }
 }
@@ -448,16 +471,26 @@ void app::glob::free_binding(const ogl::binding *p)
 
 //-----------------------------------------------------------------------------
 
-const ogl::surface *app::glob::load_surface(const std::string& name, bool cent)
+// A surface may load in the background if requested. A surface requested
+// immediately while loading in the background must wait for it.
+
+const ogl::surface *app::glob::load_surface(const std::string& name,
+                                            bool cent, bool async)
 {
     if (surface_map.find(name) == surface_map.end())
     {
         try
         {
-            if (ogl::surface *p = new ogl::surface(name, cent))
+            if (ogl::surface *p = new ogl::surface(name, cent, async))
             {
                 surface_map[name].ptr = p;
                 surface_map[name].ref = 1;
+
+                // Bake a freshly parsed surface for faster loading next time.
+                // A surface loaded in the background does so itself.
+
+                if (p->is_ready() && !p->is_cached())
+                    p->save_cache();
             }
         }
         catch (std::runtime_error&)
@@ -465,7 +498,12 @@ const ogl::surface *app::glob::load_surface(const std::string& name, bool cent)
             return 0;
         }
     }
-    else   surface_map[name].ref++;
+    else
+    {
+        surface_map[name].ref++;
+
+        if (!async) wait_surface(surface_map[name].ptr);
+    }
 
     return surface_map[name].ptr;
 }
@@ -504,6 +542,16 @@ void app::glob::free_surface(const ogl::surface *p)
     if (p) free_surface(p->get_name());
 }
 
+// Block until the given surface has finished loading in the background.
+
+void app::glob::wait_surface(const ogl::surface *p)
+{
+    std::map<std::string, surface>::iterator i;
+
+    if (p && (i = surface_map.find(p->get_name())) != surface_map.end())
+        i->second.ptr->wait();
+}
+
 //-----------------------------------------------------------------------------
 
 ogl::convex *app::glob::load_convex(const std::string& name)
@@ -564,9 +612,9 @@ void app::glob::free_convex(const ogl::convex *p)
 
 //-----------------------------------------------------------------------------
 
-ogl::pool *app::glob::new_pool()
+ogl::pool *app::glob::new_pool(bool packed)
 {
-    ogl::pool *p = new ogl::pool();
+    ogl::pool *p = new ogl::pool(packed);
 
     pool_set.insert(p);
 
@@ -633,8 +681,59 @@ void app::glob::free_frame(ogl::frame *p)
 
 //-----------------------------------------------------------------------------
 
+// Complete any background loads. Upload textures until the per-frame budget
+// is spent, releasing their proxies as they become ready.
+
+void app::glob::poll()
+{
+    std::map<std::string, texture>::iterator ti;
+    std::map<std::string, surface>::iterator si;
+
+    std::vector<const ogl::texture *> done;
+
+    size_t budget = size_t(::conf->get_i("upload_budget", 4)) << 20;
+    bool   resort = false;
+
+    for (ti = texture_map.begin(); ti != texture_map.end() && budget; ++ti)
+        if (ti->second.ptr && !ti->second.ptr->is_ready()
+                           && !ti->second.ptr->is_failed())
+        {
+            ogl::texture *p = ti->second.ptr;
+
+            budget -= std::min(budget, p->poll(budget));
+
+            if (p->is_ready())
+            {
+                if (p->opaque() != p->get_proxy()->opaque())
+                    resort = true;
+
+                done.push_back(p->get_proxy());
+            }
+        }
+
+    for (si = surface_map.begin(); si != surface_map.end(); ++si)
+        if (si->second.ptr && !si->second.ptr->is_ready())
+            si->second.ptr->poll();
+
+    // A change in opacity moves geometry between batches.
+
+    if (resort)
+    {
+        std::set<ogl::pool *>::iterator qi;
+
+        for (qi = pool_set.begin(); qi != pool_set.end(); ++qi)
+            (*qi)->set_resort_all();
+    }
+
+    for (std::vector<const ogl::texture *>::iterator i = done.begin();
+                                                     i != done.end(); ++i)
+        free_texture(*i);
+}
+
 void app::glob::prep()
 {
+    if (::loaders) poll();
+
     // Render pre-pass all OpenGL state.
 
     std::map<std::string, program>::iterator pi;
@@ -44,6 +44,10 @@
 
 #define JIFFY (1.0 / 60.0)
 
+// Each connection opens with a greeting giving its channel type and node name.
+
+#define HELLO_SIZE 64
+
 //-----------------------------------------------------------------------------
 
 #ifdef _WIN32
@@ -59,6 +63,14 @@ app::host::host(app::prog *p, std::string filename,
     script_sd(INVALID_SOCKET),
     server_sd(INVALID_SOCKET),
     clients(0),
+    barrier_server_sd(INVALID_SOCKET),
+    barrier_spin(::conf->get_i("barrier_spin", 0) != 0),
+    name(tag),
+    fanout(0),
+    relay_port(0),
+    relay_children(0),
+    parent_port(0),
+    recv_pos(0),
     bench(::conf->get_i("bench")),
     movie(::conf->get_i("movie")),
     count(0),
@@ -189,6 +201,7 @@ app::host::host(app::prog *p, std::string filename,
 
             // Start the network syncronization.
 
+            init_relay(p, tag);
             init_server(n);
             init_client(n, exe);
             init_listen(n);
@@ -203,7 +216,8 @@ app::host::host(app::prog *p, std::string filename,
 
     // Wait until all clients have connected.
 
-    while (int(client_sd.size()) < clients)
+    while (int(client_sd.size())         < clients ||
+           int(barrier_client_sd.size()) < clients)
         poll_listen(true);
 }
 
@@ -262,6 +276,50 @@ static bool selectone(SOCKET sd, struct timeval *tv)
 
 //-----------------------------------------------------------------------------
 
+// Send or receive exactly N bytes, as a single call may transfer fewer.
+
+static void send_all(SOCKET sd, const char *p, size_t n)
+{
+    while (n > 0)
+    {
+        int c = int(::send(sd, p, int(n), 0));
+
+        if (c < 0)
+        {
+            if (sock_errno != EINTR)
+                throw app::sock_error("send");
+        }
+        else
+        {
+            p += c;
+            n -= c;
+        }
+    }
+}
+
+static void recv_all(SOCKET sd, char *p, size_t n)
+{
+    while (n > 0)
+    {
+        int c = int(::recv(sd, p, int(n), 0));
+
+        if (c < 0)
+        {
+            if (sock_errno != EINTR)
+                throw app::sock_error("recv");
+        }
+        else if (c == 0)
+            throw std::runtime_error("Server closed connection");
+        else
+        {
+            p += c;
+            n -= c;
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------
+
 SOCKET app::host::init_socket(int type, int port)
 {
     SOCKET sd = INVALID_SOCKET;
@@ -305,7 +363,8 @@ SOCKET app::host::init_socket(int type, int port)
 
 void app::host::init_listen(app::node p)
 {
-    if (clients) listen_sd = init_socket(SOCK_STREAM, p.get_i("port"));
+    if (clients) listen_sd = init_socket(SOCK_STREAM, fanout ? relay_port
+                                                             : p.get_i("port"));
 }
 
 void app::host::poll_listen(bool wait)
@@ -316,7 +375,8 @@ void app::host::poll_listen(bool wait)
     {
         if (selectone(listen_sd, wait ? 0 : &tv))
         {
-            // Accept any incoming client connection.
+            // Accept any incoming client connection.  Its greeting tells
+            // whether it carries events or the swap barrier.
 
             if (int sd = accept(listen_sd, 0, 0))
             {
@@ -324,8 +384,19 @@ void app::host::poll_listen(bool wait)
                     throw app::sock_error("accept");
                 else
                 {
+                    char hello[HELLO_SIZE];
+
                     nodelay(sd);
-                    client_sd.push_back(sd);
+                    recv_all(sd, hello, HELLO_SIZE);
+
+                    hello[HELLO_SIZE - 1] = '\0';
+
+                    if (hello[0] == 'B')
+                    {
+                        barrier_client_sd  .push_back(sd);
+                        barrier_client_name.push_back(hello + 1);
+                    }
+                    else client_sd.push_back(sd);
                 }
             }
         }
@@ -388,41 +459,75 @@ void app::host::fini_script()
 
 //-----------------------------------------------------------------------------
 
-void app::host::init_server(app::node p)
+// Connect to the named server and greet it with the given channel type and the
+// name of this node.
+
+SOCKET app::host::init_connect(const std::string& addr, int port, char type)
 {
-    // If we have a server assignment then we must connect to it.
+    socklen_t  addresslen = sizeof (sockaddr_t);
+    sockaddr_t address;
+    SOCKET     sd;
+
+    // Look up the given host name.
 
-    if (app::node n = p.find("server"))
+    if (init_sockaddr(address, addr.c_str(), port))
     {
-        socklen_t  addresslen = sizeof (sockaddr_t);
-        sockaddr_t address;
+        // Create a socket and connect.
 
-        std::string name = n.get_s("addr");
-        int         port = n.get_i("port");
+        if ((sd = socket(AF_INET, SOCK_STREAM, 0)) == INVALID_SOCKET)
+            throw app::sock_error(addr);
 
-        if (name.empty()) name = DEFAULT_HOST;
-        if (port == 0)    port = DEFAULT_PORT;
+        while (connect(sd, (struct sockaddr *) &address, addresslen) < 0)
+            if (sock_errno == ECONNREFUSED)
+            {
+                fprintf(stderr, "Waiting for %s\n", addr.c_str());
+                usleep(250000);
+            }
+            else throw app::sock_error(addr);
 
-        // Look up the given host name.
+        nodelay(sd);
+    }
+    else throw app::sock_error(addr);
 
-        if (init_sockaddr(address, name.c_str(), port))
-        {
-            // Create a socket and connect.
+    // Send the greeting.
 
-            if ((server_sd = socket(AF_INET, SOCK_STREAM, 0)) == INVALID_SOCKET)
-                throw app::sock_error(name);
+    char hello[HELLO_SIZE];
 
-            while (connect(server_sd, (struct sockaddr *) &address, addresslen) <0)
-                if (sock_errno == ECONNREFUSED)
-                {
-                    fprintf(stderr, "Waiting for %s\n", name.c_str());
-                    usleep(250000);
-                }
-                else throw app::sock_error(name);
+    memset(hello, 0, HELLO_SIZE);
+    strncpy(hello + 1, name.c_str(), HELLO_SIZE - 2);
+    hello[0] = type;
 
-            nodelay(server_sd);
+    send_all(sd, hello, HELLO_SIZE);
+
+    return sd;
+}
+
+void app::host::init_server(app::node p)
+{
+    // If we have a server assignment then we must connect to it.  Within a
+    // relay tree, the server of a client may be its parent relay.
+
+    std::string addr = parent_addr;
+    int         port = parent_port;
+
+    if (addr.empty())
+        if (app::node n = p.find("server"))
+        {
+            addr = n.get_s("addr");
+            port = n.get_i("port");
+
+            if (addr.empty()) addr = DEFAULT_HOST;
         }
-        else throw app::sock_error(name);
+
+    // Connect the barrier first, so that it is accepted before any event
+    // arrives that would have this node await the barrier.
+
+    if (!addr.empty())
+    {
+        if (port == 0) port = DEFAULT_PORT;
+
+        barrier_server_sd = init_connect(addr, port, 'B');
+        server_sd         = init_connect(addr, port, 'E');
     }
 }
 
@@ -433,6 +538,71 @@ void app::host::fini_server()
         close(server_sd);
         server_sd  = INVALID_SOCKET;
     }
+    if (barrier_server_sd != INVALID_SOCKET)
+    {
+        close(barrier_server_sd);
+        barrier_server_sd  = INVALID_SOCKET;
+    }
+}
+
+//-----------------------------------------------------------------------------
+
+// A root node with a fanout attribute K arranges its clients in a K-ary relay
+// tree, in the order given.  The root accepts only the first K clients.  Client
+// I accepts clients K(I+1) through K(I+1)+K-1 on the root's port plus I+1, and
+// relays to them every frame it receives.  A client is reached at its ip
+// attribute, or its addr, which must then be numeric.  As all ports differ,
+// a tree may be tested on one host over loopback.
+
+void app::host::init_relay(app::node p, const std::string& tag)
+{
+    for (app::node r = p.find("node"); r; r = p.next(r, "node"))
+        if (r.get_i("fanout") > 0)
+        {
+            std::vector<std::string> name;
+            std::vector<std::string> addr;
+
+            for (app::node c = r.find("client"); c; c = r.next(c, "client"))
+            {
+                const std::string ip = c.get_s("ip");
+
+                name.push_back(c.get_s("name"));
+                addr.push_back(ip.empty() ? c.get_s("addr") : ip);
+            }
+
+            const int k = r.get_i("fanout");
+            const int n = int(name.size());
+            const int b = r.get_i("port", DEFAULT_PORT);
+
+            // Find this node in the tree: the root, a client, or neither.
+
+            int i = -1;
+
+            if (r.get_s("name") != tag)
+            {
+                i = int(std::find(name.begin(), name.end(), tag) - name.begin());
+
+                if (i == n) return;
+            }
+
+            // Clients below the first level connect to their parent relay.
+
+            const int j = i / k - 1;
+
+            if (i >= 0 && j >= 0)
+            {
+                parent_addr = addr[j];
+                parent_port = b + j + 1;
+            }
+
+            // Count the children and choose a port upon which to accept them.
+
+            fanout         = k;
+            relay_port     = b + i + 1;
+            relay_children = std::max(0, std::min(n, k * (i + 2)) - k * (i + 1));
+
+            return;
+        }
 }
 
 //-----------------------------------------------------------------------------
@@ -449,6 +619,10 @@ void app::host::init_client(app::node p, const std::string& exe)
                                 exe.c_str());
         clients++;
     }
+
+    // Within a relay tree, await only this node's children.
+
+    if (fanout) clients = relay_children;
 }
 
 void app::host::fini_client()
@@ -469,6 +643,12 @@ void app::host::fini_client()
 
         client_sd.pop_front();
     }
+
+    for (size_t i = 0; i < barrier_client_sd.size(); ++i)
+        close(barrier_client_sd[i]);
+
+    barrier_client_sd  .clear();
+    barrier_client_name.clear();
 }
 
 void app::host::fork_client(const char *name,
@@ -662,8 +842,6 @@ void app::host::root_loop()
             if (swapped == false)
                 process_event(E.mk_swap());
 
-            ::perf->step(false);
-
             // Count frames and record a movie, if requested.
 
             if (movie)
@@ -701,7 +879,7 @@ void app::host::node_loop()
     event E;
 
     while (program->is_running())
-        process_event(E.recv(server_sd));
+        process_event(recv(&E));
 }
 
 void app::host::loop()
@@ -732,10 +910,16 @@ void app::host::draw()
     int frusc = int(frustums.size());
     int frusi = 0;
 
+    app::perf_scope frame("draw");
+
     // Prepare all displays for rendering (cheap).
 
-    for (dpy::display_i i = displays.begin(); i != displays.end(); ++i)
-        (*i)->prep(chanc, chanv);
+    {
+        app::perf_scope scope("prep");
+
+        for (dpy::display_i i = displays.begin(); i != displays.end(); ++i)
+            (*i)->prep(chanc, chanv);
+    }
 
     // Cache the transformed frustum planes (cheap).
 
@@ -744,7 +928,11 @@ void app::host::draw()
 
     // Determine visibility (moderately expensive).
 
-    ogl::aabb bound = program->prep(frusc, frusv);
+    ogl::aabb bound;
+    {
+        app::perf_scope scope("visibility");
+        bound = program->prep(frusc, frusv);
+    }
 
     // Cache the frustum projections (cheap).
 
@@ -753,11 +941,17 @@ void app::host::draw()
 
     // Perform the lighting prepass (possibly expensive).
 
-    program->lite(frusc, frusv);
+    {
+        app::perf_scope scope("lite");
+        program->lite(frusc, frusv);
+    }
 
     // Update all modified uniforms.
 
-    ::glob->prep();
+    {
+        app::perf_scope scope("glob");
+        ::glob->prep();
+    }
 
     // Switch to off-screen if necessary.
 
@@ -768,6 +962,8 @@ void app::host::draw()
 
     for (dpy::display_i i = displays.begin(); i != displays.end(); ++i)
     {
+        app::perf_scope scope("display");
+
         if (calibration_state)
             (*i)->test(chanc, chanv, calibration_index);
         else
@@ -780,6 +976,8 @@ void app::host::draw()
 
     if (render)
     {
+        app::perf_scope scope("render");
+
         render->free();
         render->draw();
     }
@@ -792,41 +990,187 @@ void app::host::draw(int frusi, const app::frustum *frusp, int chani)
 
 void app::host::swap() const
 {
-    // If doing network sync, wait until the rendering has finished.
+    {
+        app::perf_scope scope("swap");
+
+        // If doing network sync, wait until the rendering has finished.
+
+        if (server_sd != INVALID_SOCKET || !client_sd.empty())
+            glFinish();
+
+        program->swap();
+    }
 
-    if (server_sd != INVALID_SOCKET || !client_sd.empty())
-        glFinish();
+    // Close the frame's perf timings, on the root and clients alike.
 
-    program->swap();
+    if (::perf) ::perf->step(false);
 }
 
 //-----------------------------------------------------------------------------
 
-// Send the given event to all connected clients.
+// Queue the given event for all connected clients. The events of a frame are
+// coalesced and sent together once clients must act upon them: before drawing,
+// before any barrier, and at start and close. A node other than the root has
+// already relayed each frame whole upon receipt.
 
 void app::host::send(event *E)
 {
-    for (SOCKET_i i = client_sd.begin(); i != client_sd.end(); ++i)
-        E->send(*i);
+    if (root() && !client_sd.empty())
+    {
+        if (send_buf.empty())
+            send_buf.resize(sizeof (uint32_t));
+
+        E->put(send_buf);
+
+        switch (E->get_type())
+        {
+        case E_DRAW:
+        case E_SWAP:
+        case E_START:
+        case E_CLOSE: flush();
+        }
+    }
+}
+
+// Send all queued events to all connected clients as a single frame, prefixed
+// by its length.
+
+void app::host::flush()
+{
+    if (send_buf.size() > sizeof (uint32_t))
+    {
+        const uint32_t n = htonl(uint32_t(send_buf.size() - sizeof (uint32_t)));
+
+        memcpy(&send_buf.front(), &n, sizeof (uint32_t));
+
+        for (SOCKET_i i = client_sd.begin(); i != client_sd.end(); ++i)
+            send_all(*i, &send_buf.front(), send_buf.size());
+    }
+    send_buf.clear();
 }
 
-// Barrier-sync. Await an acknowledgement from all connected clients and
-// send an acknowledgement to the server. This has the effect of a tree-
-// wide recursive barrier synchronization.
+// Return the next event from the server, receiving a new frame as needed.
+
+app::event *app::host::recv(event *E)
+{
+    while (recv_pos >= recv_buf.size())
+    {
+        uint32_t n;
+
+        recv_all(server_sd, (char *) &n, sizeof (uint32_t));
+
+        recv_buf.resize(ntohl(n));
+        recv_pos = 0;
+
+        if (!recv_buf.empty())
+            recv_all(server_sd, &recv_buf.front(), recv_buf.size());
+
+        // Relay the frame to all clients before acting upon any of it.
+
+        for (SOCKET_i i = client_sd.begin(); i != client_sd.end(); ++i)
+        {
+            send_all(*i, (const char *) &n, sizeof (uint32_t));
+
+            if (!recv_buf.empty())
+                send_all(*i, &recv_buf.front(), recv_buf.size());
+        }
+    }
+    return E->get(recv_buf, recv_pos);
+}
+
+// Barrier-sync. Await an acknowledgement from all connected clients and send
+// an acknowledgement to the server. Then await the release from the server and
+// release all clients. Acknowledgements are thus reduced up the tree, and the
+// release reaches every node in a number of hops given by the tree depth.
+
+//
+// All of this occurs on the dedicated barrier channel, so that no event data
+// queues ahead of an acknowledgement.  Each acknowledgement is timed as it
+// arrives and reported to the perf subsystem along with the time spent awaiting
+// release.  With the barrier_spin option, waits poll rather than block, which
+// trades a CPU core for lower wake-up latency.
 
 void app::host::sync()
 {
+    app::perf_scope scope("sync");
+
+    struct timeval tv = { 0, 0 };
+
+    const Uint64 t0 = SDL_GetPerformanceCounter();
+    const double ms = 1000.0 / SDL_GetPerformanceFrequency();
+
     char buf[1] = { '\0' };
 
-    // Recieve a message from all connected clients.
+    // Recieve an acknowledgement from all connected clients, in arrival order.
+
+    std::vector<bool> done(barrier_client_sd.size(), false);
+    size_t            todo = done.size();
 
-    for (SOCKET_i i = client_sd.begin(); i != client_sd.end(); ++i)
-        ::recv(*i,        buf, 1, 0);
+    while (todo)
+    {
+        fd_set fds;
+        SOCKET top = 0;
 
-    // Send a message to any connected server.
+        FD_ZERO(&fds);
 
-    if (server_sd != INVALID_SOCKET)
-        ::send(server_sd, buf, 1, 0);
+        for (size_t i = 0; i < done.size(); ++i)
+            if (!done[i])
+            {
+                FD_SET(barrier_client_sd[i], &fds);
+                top = std::max(top, barrier_client_sd[i]);
+            }
+
+        tv.tv_sec  = 0;
+        tv.tv_usec = 0;
+
+        int n = select(top + 1, &fds, NULL, NULL, barrier_spin ? &tv : NULL);
+
+        if (n < 0 && sock_errno != EINTR)
+            throw app::sock_error("select");
+
+        if (n > 0)
+        {
+            const double t = (SDL_GetPerformanceCounter() - t0) * ms;
+
+            for (size_t i = 0; i < done.size(); ++i)
+                if (!done[i] && FD_ISSET(barrier_client_sd[i], &fds))
+                {
+                    recv_all(barrier_client_sd[i], buf, 1);
+
+                    if (::perf)
+                        ::perf->barrier_arrive(barrier_client_name[i], t);
+
+                    done[i] = true;
+                    todo--;
+                }
+        }
+    }
+
+    // Acknowledge to, and await the release of, any connected server.
+
+    double wait = 0;
+
+    if (barrier_server_sd != INVALID_SOCKET)
+    {
+        const Uint64 t1 = SDL_GetPerformanceCounter();
+
+        send_all(barrier_server_sd, buf, 1);
+
+        if (barrier_spin)
+            while (!selectone(barrier_server_sd, &tv))
+                tv.tv_usec = 0;
+
+        recv_all(barrier_server_sd, buf, 1);
+
+        wait = (SDL_GetPerformanceCounter() - t1) * ms;
+    }
+
+    // Release all connected clients.
+
+    for (size_t i = 0; i < barrier_client_sd.size(); ++i)
+        send_all(barrier_client_sd[i], buf, 1);
+
+    if (::perf) ::perf->barrier_finish(wait);
 }
 
 //-----------------------------------------------------------------------------
@@ -10,6 +10,7 @@
 //  MERCHANTABILITY  or FITNESS  FOR A  PARTICULAR PURPOSE.   See  the GNU
 //  General Public License for more details.
 
+#include <algorithm>
 #include <iostream>
 #include <sstream>
 #include <iomanip>
@@ -17,10 +18,342 @@
 #include <SDL.h>
 
 #include <ogl-opengl.hpp>
+#include <app-conf.hpp>
 #include <app-perf.hpp>
 
 // TODO: Convert this away from iostream.
 
+//-----------------------------------------------------------------------------
+
+app::perf_barrier::perf_barrier() : skew(0), wait(0), log(0), barrier_frame(0)
+{
+    std::string file = ::conf->get_s("barrier_log");
+
+    if (!file.empty())
+        log = fopen(file.c_str(), "w");
+
+    barrier_reset();
+}
+
+app::perf_barrier::~perf_barrier()
+{
+    if (log) fclose(log);
+}
+
+void app::perf_barrier::barrier_arrive(const std::string& n, double t)
+{
+    name.push_back(n);
+    time.push_back(t);
+}
+
+void app::perf_barrier::barrier_finish(double w)
+{
+    // Find the latest arrival of this frame.
+
+    skew = 0;
+    wait = w;
+    late.clear();
+
+    for (size_t i = 0; i < time.size(); ++i)
+        if (late.empty() || time[i] > skew)
+        {
+            skew = time[i];
+            late = name[i];
+        }
+
+    // Accumulate for the periodic report.
+
+    if (!time.empty())
+    {
+        sum_frames += 1;
+        sum_skew   += skew;
+
+        if (max_late.empty() || skew > max_skew)
+        {
+            max_skew = skew;
+            max_late = late;
+        }
+    }
+
+    // Log all arrivals, if requested.
+
+    if (log)
+    {
+        fprintf(log, "%d %.3f %.3f", barrier_frame, skew, wait);
+
+        for (size_t i = 0; i < time.size(); ++i)
+            fprintf(log, " %s:%.3f", name[i].c_str(), time[i]);
+
+        fprintf(log, "\n");
+    }
+
+    name.clear();
+    time.clear();
+    barrier_frame++;
+}
+
+void app::perf_barrier::barrier_reset()
+{
+    sum_frames = 0;
+    sum_skew   = 0;
+    max_skew   = 0;
+    max_late.clear();
+}
+
+//-----------------------------------------------------------------------------
+
+void app::perf_timer::ring::put(double d, size_t limit)
+{
+    if (v.size() < limit)
+        v.push_back(d);
+    else
+        v[n % limit] = d;
+    n++;
+}
+
+double app::perf_timer::ring::get(double p) const
+{
+    if (v.empty()) return 0;
+
+    std::vector<double> w(v);
+
+    size_t k = std::min(w.size() - 1, size_t(p * w.size()));
+
+    std::nth_element(w.begin(), w.begin() + k, w.end());
+
+    return w[k];
+}
+
+//-----------------------------------------------------------------------------
+
+app::perf_timer::perf_timer() :
+    frames(DEFAULT_PERF_LATENCY),
+    current(0),
+    gpu(ogl::has_timer_query && ::conf->get_i("perf_gpu", 1)),
+    limit(std::max(1, ::conf->get_i("perf_history", DEFAULT_PERF_HISTORY))),
+    verbose(::conf->get_i("perf_report", 0) != 0),
+    epoch(SDL_GetPerformanceCounter()),
+    gpu_offset(0),
+    gpu_anchored(false),
+    csv(0),
+    trace(0),
+    trace_first(true)
+{
+    std::string csv_file   = ::conf->get_s("perf_csv");
+    std::string trace_file = ::conf->get_s("perf_trace");
+
+    if (!csv_file.empty() && (csv = fopen(csv_file.c_str(), "w")))
+        fprintf(csv, "frame,section,depth,start,cpu,gpu\n");
+
+    if (!trace_file.empty() && (trace = fopen(trace_file.c_str(), "w")))
+        fprintf(trace, "[\n");
+
+    frames[0].number = 0;
+}
+
+app::perf_timer::~perf_timer()
+{
+    for (size_t i = 0; i < frames.size(); ++i)
+        if (!frames[i].queries.empty())
+            glDeleteQueries(GLsizei(frames[i].queries.size()),
+                                   &frames[i].queries.front());
+
+    if (csv)   fclose(csv);
+    if (trace)
+    {
+        fprintf(trace, "\n]\n");
+        fclose(trace);
+    }
+}
+
+// Take a query object from the current frame's pool, growing it as needed.
+
+unsigned int app::perf_timer::query()
+{
+    pending& f = frames[current];
+
+    if (f.used == f.queries.size())
+    {
+        GLuint q;
+        glGenQueries(1, &q);
+        f.queries.push_back(q);
+    }
+    return f.queries[f.used++];
+}
+
+void app::perf_timer::push(const char *name)
+{
+    pending& f = frames[current];
+    section  s;
+
+    s.name   = name;
+    s.parent = stack.empty() ? -1 : stack.back();
+    s.cpu[0] = SDL_GetPerformanceCounter();
+    s.cpu[1] = s.cpu[0];
+    s.gpu[0] = 0;
+    s.gpu[1] = 0;
+
+    if (gpu)
+        glQueryCounter(s.gpu[0] = query(), GL_TIMESTAMP);
+
+    stack.push_back(int(f.sections.size()));
+    f.sections.push_back(s);
+}
+
+void app::perf_timer::pop()
+{
+    if (!stack.empty())
+    {
+        section& s = frames[current].sections[stack.back()];
+
+        if (gpu)
+            glQueryCounter(s.gpu[1] = query(), GL_TIMESTAMP);
+
+        s.cpu[1] = SDL_GetPerformanceCounter();
+
+        stack.pop_back();
+    }
+}
+
+// End the current frame and begin the next, harvesting the oldest frame in
+// flight.  Its GPU results are usually ready by now.  If not, they are dropped
+// rather than waited upon.
+
+void app::perf_timer::frame()
+{
+    while (!stack.empty()) pop();
+
+    int number = frames[current].number;
+
+    current = (current + 1) % int(frames.size());
+
+    harvest(frames[current]);
+
+    frames[current].number = number + 1;
+    frames[current].used   = 0;
+    frames[current].sections.clear();
+}
+
+void app::perf_timer::harvest(pending& f)
+{
+    if (f.sections.empty()) return;
+
+    const double ms = 1000.0 / SDL_GetPerformanceFrequency();
+
+    // Determine whether the GPU results of this frame are all available.
+
+    bool ready = false;
+
+    if (gpu && f.used)
+    {
+        GLint available = 0;
+        glGetQueryObjectiv(f.queries[f.used - 1], GL_QUERY_RESULT_AVAILABLE,
+                                                  &available);
+        ready = (available != 0);
+    }
+
+    std::vector<std::string> path(f.sections.size());
+    std::vector<int>         depth(f.sections.size());
+
+    for (size_t i = 0; i < f.sections.size(); ++i)
+    {
+        const section& s = f.sections[i];
+
+        // Compose the path of this section.  Parents precede children.
+
+        if (s.parent < 0)
+        {
+            path [i] = s.name;
+            depth[i] = 0;
+        }
+        else
+        {
+            path [i] = path[s.parent] + "/" + s.name;
+            depth[i] = depth[s.parent] + 1;
+        }
+
+        // Compute the times and record them.
+
+        double start = (s.cpu[0] - epoch)  * ms;
+        double cpu_t = (s.cpu[1] - s.cpu[0]) * ms;
+        double gpu_0 = 0;
+        double gpu_t = -1;
+
+        stats[path[i]].cpu.put(cpu_t, limit);
+
+        if (ready)
+        {
+            GLuint64 t0;
+            GLuint64 t1;
+
+            glGetQueryObjectui64v(s.gpu[0], GL_QUERY_RESULT, &t0);
+            glGetQueryObjectui64v(s.gpu[1], GL_QUERY_RESULT, &t1);
+
+            // Align the GPU clock with the CPU clock at the first sample.
+
+            if (!gpu_anchored)
+            {
+                gpu_offset   = start - t0 / 1e6;
+                gpu_anchored = true;
+            }
+
+            gpu_0 = t0 / 1e6 + gpu_offset;
+            gpu_t = (t1 - t0) / 1e6;
+
+            stats[path[i]].gpu.put(gpu_t, limit);
+        }
+
+        // Export, as requested.
+
+        if (csv)
+            fprintf(csv, "%d,%s,%d,%.4f,%.4f,%.4f\n", f.number,
+                    path[i].c_str(), depth[i], start, cpu_t, gpu_t);
+
+        if (trace)
+        {
+            fprintf(trace, "%s{\"name\":\"%s\",\"cat\":\"cpu\",\"ph\":\"X\","
+                           "\"pid\":0,\"tid\":0,\"ts\":%.1f,\"dur\":%.1f}",
+                    trace_first ? "" : ",\n", s.name, start * 1000, cpu_t * 1000);
+
+            if (gpu_t >= 0)
+                fprintf(trace, ",\n{\"name\":\"%s\",\"cat\":\"gpu\",\"ph\":\"X\","
+                               "\"pid\":0,\"tid\":1,\"ts\":%.1f,\"dur\":%.1f}",
+                        s.name, gpu_0 * 1000, gpu_t * 1000);
+
+            trace_first = false;
+        }
+    }
+}
+
+double app::perf_timer::get_cpu(const std::string& path, double p) const
+{
+    std::map<std::string, history>::const_iterator i = stats.find(path);
+    return (i == stats.end()) ? 0 : i->second.cpu.get(p);
+}
+
+double app::perf_timer::get_gpu(const std::string& path, double p) const
+{
+    std::map<std::string, history>::const_iterator i = stats.find(path);
+    return (i == stats.end()) ? 0 : i->second.gpu.get(p);
+}
+
+// Print the median and tail times of all sections, if requested.
+
+void app::perf_timer::report() const
+{
+    if (verbose && !stats.empty())
+    {
+        printf("%-40s %8s %8s %8s %8s\n", "section", "cpu p50", "cpu p95",
+                                                     "gpu p50", "gpu p95");
+
+        for (std::map<std::string, history>::const_iterator i = stats.begin();
+                                                           i != stats.end(); ++i)
+            printf("%-40s %8.3f %8.3f %8.3f %8.3f\n", i->first.c_str(),
+                   i->second.cpu.get(0.50), i->second.cpu.get(0.95),
+                   i->second.gpu.get(0.50), i->second.gpu.get(0.95));
+    }
+}
+
 #ifdef NVPM //=================================================================
 
 std::map<UINT, char *> app::perf::_name;
@@ -81,6 +414,8 @@ app::perf::~perf()
 
 void app::perf::step(bool log)
 {
+    frame();
+
     if (val && avg)
     {
         // Sample the current counter values.
@@ -139,6 +474,8 @@ void app::perf::dump(bool log)
 
     memset(avg, 0, num * sizeof (NVPMSampleValue));
     tot = 0;
+
+    report();
 }
 
 #else // not NVPM =============================================================
@@ -161,6 +498,8 @@ app::perf::~perf()
 
 void app::perf::step(bool log)
 {
+    frame();
+
     // Count a frame.
 
     local_frames++;
@@ -200,9 +539,20 @@ void app::perf::dump(bool log)
                                        << "(" << mn  << "ms) "
                                               << fps << "fps";
 
+    // Report the swap barrier skew, and the worst straggler, if any.
+
+    if (sum_frames)
+        str << std::setprecision(2) << " sync " << sum_skew / sum_frames
+                                    << "ms (" << max_late << " "
+                                    << max_skew << "ms)";
+
+    barrier_reset();
+
     SDL_SetWindowTitle(window, str.str().c_str());
 
     if (log) std::cout << str.str() << std::endl;
+
+    report();
 }
 
 #endif // not NVPM ============================================================
@@ -14,6 +14,7 @@
 #include <png.h>
 
 #include <stdexcept>
+#include <algorithm>
 
 #ifdef _WIN32
 #include <io.h>
@@ -26,6 +27,7 @@
 #include <app-event.hpp>
 #include <etc-vector.hpp>
 #include <etc-log.hpp>
+#include <etc-task.hpp>
 
 #include <app-prog.hpp>
 #include <app-conf.hpp>
@@ -54,6 +56,9 @@ app::lang *lang = 0;
 app::host *host = 0;
 app::perf *perf = 0;
 
+etc::worker_pool *workers = 0;
+etc::worker_pool *loaders = 0;
+
 //-----------------------------------------------------------------------------
 
 #define XTR(S) #S
@@ -156,12 +161,14 @@ void app::prog::host_dn()
 {
     ::glob->fini();
 
-    video_dn();
+    // The perf timers hold GL queries, so release them before the context.
 
     delete ::perf;
-    delete ::host;
-
     ::perf = 0;
+
+    video_dn();
+
+    delete ::host;
     ::host = 0;
 }
 
@@ -191,6 +198,16 @@ app::prog::prog(const std::string& exe,
 
     ::data->init();
 
+    // Start the worker threads.
+
+    ::workers = new etc::worker_pool(::conf->get_i("worker_threads", 0));
+
+    // Start the background loader threads. These must not be empty, as no
+    // caller ever waits upon a background load.
+
+    if (::conf->get_i("async_loading", 1))
+        ::loaders = new etc::worker_pool(std::max(::conf->get_i("loader_threads", 1), 1));
+
     // Initialize the input handlers.
 
     std::string input_mode = ::conf->get_s("input_mode");
@@ -240,11 +257,20 @@ app::prog::~prog()
     if (mouse)  delete mouse;
     if (input)  delete input;
 
+    // Finish any tasks in flight, as these may use the globals below.
+
+    if (::loaders) ::loaders->wait();
+    if (::workers) ::workers->wait();
+
     if (::perf) delete ::perf;
     if (::view) delete ::view;
     if (::host) delete ::host;
     if (::glob) delete ::glob;
     if (::lang) delete ::lang;
+
+    if (::loaders) delete ::loaders;
+    if (::workers) delete ::workers;
+
     if (::conf) delete ::conf;
     if (::data) delete ::data;
 
@@ -333,10 +359,12 @@ void app::prog::dump(std::string name)
     unsigned char *p = 0;
     size_t         n = 0;
 
-    if ((p = (unsigned char *) ::data->load(name, &n)))
+    if ((p = (unsigned char *) ::data->load(name, &n, false)))
     {
         for (size_t i = 0; i < n; i++)
             putchar(int(p[i]));
+
+        ::data->free(name);
     }
 }
 
@@ -88,27 +88,34 @@ void dpy::fulldome::draw(int chanc, const dpy::channel *const *chanv, int frusi)
 
     // Draw the off-screen buffer to the screen.
 
+    static const ogl::program::handle P[] = {
+        ogl::program::handle("P[0]"),
+        ogl::program::handle("P[1]"),
+        ogl::program::handle("P[2]"),
+        ogl::program::handle("P[3]")
+    };
+
     program->bind();
     {
         if (chanc > 0 && frusc > 0)
         {
             chanv[0]->bind_color(GL_TEXTURE0);
-            program->uniform("P[0]", frusta[0]->get_transform(), false);
+            program->uniform(P[0], frusta[0]->get_transform(), false);
         }
         if (chanc > 1 && frusc > 1)
         {
             chanv[1]->bind_color(GL_TEXTURE1);
-            program->uniform("P[1]", frusta[1]->get_transform(), false);
+            program->uniform(P[1], frusta[1]->get_transform(), false);
         }
         if (chanc > 2 && frusc > 2)
         {
             chanv[2]->bind_color(GL_TEXTURE2);
-            program->uniform("P[2]", frusta[2]->get_transform(), false);
+            program->uniform(P[2], frusta[2]->get_transform(), false);
         }
         if (chanc > 3 && frusc > 3)
         {
             chanv[3]->bind_color(GL_TEXTURE3);
-            program->uniform("P[3]", frusta[3]->get_transform(), false);
+            program->uniform(P[3], frusta[3]->get_transform(), false);
         }
 
         fill(viewport[2], viewport[3], 0, 0);
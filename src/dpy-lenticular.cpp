@@ -9,6 +9,7 @@
 //  General Public License for more details.
 
 #include <cassert>
+#include <sstream>
 
 #include <SDL.h>
 #include <SDL_keyboard.h>
@@ -24,6 +25,20 @@
 
 //-----------------------------------------------------------------------------
 
+static const char *shared_uniform[] = {
+    "eyes", "quality", "offset", "corner", "size"
+};
+
+static const char *channel_uniform[] = {
+    "coeff", "edge0", "edge1", "edge2", "edge3",
+    "edge4", "edge5", "edge6", "depth"
+};
+
+static const int shared_uniforms  = 5;
+static const int channel_uniforms = 9;
+
+//-----------------------------------------------------------------------------
+
 dpy::lenticular::lenticular(app::node p) :
     display(p),
 
@@ -79,6 +94,21 @@ dpy::lenticular::lenticular(app::node p) :
             slice[i].step3 = n.get_f("step3");
             slice[i].depth = n.get_f("depth");
         }
+
+    // Name the uniforms once, as apply_uniforms sets them every frame.
+
+    for (i = 0; i < shared_uniforms; ++i)
+        uniforms.push_back(ogl::program::handle(shared_uniform[i]));
+
+    for (int j = 0; j < channels; ++j)
+        for (i = 0; i < channel_uniforms; ++i)
+        {
+            std::ostringstream name;
+
+            name << channel_uniform[i] << "[" << j << "]";
+
+            uniforms.push_back(ogl::program::handle(name.str()));
+        }
 }
 
 dpy::lenticular::~lenticular()
@@ -339,22 +369,17 @@ vec4 dpy::lenticular::calc_transform(const vec3& u) const
 
 void dpy::lenticular::apply_uniforms() const
 {
-    static const std::string index[] = {
-        "[0]",  "[1]",  "[2]",  "[3]",  "[4]",  "[5]",  "[6]",  "[7]",
-        "[8]",  "[9]", "[10]", "[11]", "[12]", "[13]", "[14]", "[15]"
-    };
+    const ogl::program::handle *u = &uniforms.front();
 
     const double w = frust[0]->get_width();
     const double h = frust[0]->get_height();
     const double d = w / (3 * viewport[2]);
 
-    // TODO: cache these uniform locations (in process_start).
-
-    program->uniform("eyes",    channels);
-    program->uniform("quality", quality);
-    program->uniform("offset",  vec3(-d, 0, d));
-    program->uniform("corner",  vec2(viewport[0], viewport[1]));
-    program->uniform("size",    vec4(w * 0.5, h * 0.5, 0.0, 1.0));
+    program->uniform(u[0], channels);
+    program->uniform(u[1], quality);
+    program->uniform(u[2], vec3(-d, 0, d));
+    program->uniform(u[3], vec2(viewport[0], viewport[1]));
+    program->uniform(u[4], vec4(w * 0.5, h * 0.5, 0.0, 1.0));
 
     for (int i = 0; i < channels; ++i)
     {
@@ -382,17 +407,20 @@ void dpy::lenticular::apply_uniforms() const
 
         // Set all uniform values.
 
-        program->uniform("coeff" + index[i], v);
-        program->uniform("edge0" + index[i], vec3(e0, e0, e0));
-        program->uniform("edge1" + index[i], vec3(e1, e1, e1));
-        program->uniform("edge2" + index[i], vec3(e2, e2, e2));
-        program->uniform("edge3" + index[i], vec3(e3, e3, e3));
-        program->uniform("edge4" + index[i], vec3(e4, e4, e4));
-        program->uniform("edge5" + index[i], vec3(e5, e5, e5));
-        program->uniform("edge6" + index[i], vec3(e6, e6, e6));
-        program->uniform("depth" + index[i], vec3(-slice[i].depth,
-                                                  -slice[i].depth,
-                                                  -slice[i].depth));
+        const ogl::program::handle *k = u + shared_uniforms
+                                          + channel_uniforms * i;
+
+        program->uniform(k[0], v);
+        program->uniform(k[1], vec3(e0, e0, e0));
+        program->uniform(k[2], vec3(e1, e1, e1));
+        program->uniform(k[3], vec3(e2, e2, e2));
+        program->uniform(k[4], vec3(e3, e3, e3));
+        program->uniform(k[5], vec3(e4, e4, e4));
+        program->uniform(k[6], vec3(e5, e5, e5));
+        program->uniform(k[7], vec3(e6, e6, e6));
+        program->uniform(k[8], vec3(-slice[i].depth,
+                                    -slice[i].depth,
+                                    -slice[i].depth));
     }
 }
 
@@ -16,6 +16,7 @@
 #include <app-glob.hpp>
 #include <app-host.hpp>
 #include <app-event.hpp>
+#include <app-perf.hpp>
 #include <app-frustum.hpp>
 #include <ogl-program.hpp>
 #include <dpy-channel.hpp>
@@ -82,7 +83,10 @@ void dpy::normal::draw(int chanc, const dpy::channel *const *chanv, int frusi)
             ::host->draw(frusi, frust, chani);
         }
         chanv[chani]->free();
-        chanv[chani]->proc();
+        {
+            app::perf_scope scope("proc");
+            chanv[chani]->proc();
+        }
 
         // Draw the off-screen buffer to the screen.
 
@@ -0,0 +1,170 @@
+//  Copyright (C) 2014 Robert Kooima
+//
+//  THUMB is free software; you can redistribute it and/or modify it under
+//  the terms of  the GNU General Public License as  published by the Free
+//  Software  Foundation;  either version 2  of the  License,  or (at your
+//  option) any later version.
+//
+//  This program  is distributed in the  hope that it will  be useful, but
+//  WITHOUT   ANY  WARRANTY;   without  even   the  implied   warranty  of
+//  MERCHANTABILITY  or FITNESS  FOR A  PARTICULAR PURPOSE.   See  the GNU
+//  General Public License for more details.
+
+#include <etc-task.hpp>
+
+//-----------------------------------------------------------------------------
+
+etc::worker_pool::worker_pool(int n) : busy(0), stop(false)
+{
+    mutex = SDL_CreateMutex();
+    wake  = SDL_CreateCond();
+    idle  = SDL_CreateCond();
+
+    // By default, leave one core to the calling thread, which joins in.
+
+    if (n <= 0) n = SDL_GetCPUCount() - 1;
+
+    for (int i = 0; i < n; ++i)
+        if (SDL_Thread *t = SDL_CreateThread(loop, "worker", this))
+            threads.push_back(t);
+}
+
+etc::worker_pool::~worker_pool()
+{
+    // Signal all threads to exit and wait for them to do so.
+
+    SDL_LockMutex(mutex);
+    {
+        stop = true;
+        SDL_CondBroadcast(wake);
+    }
+    SDL_UnlockMutex(mutex);
+
+    for (std::vector<SDL_Thread *>::iterator i = threads.begin();
+                                             i != threads.end(); ++i)
+        SDL_WaitThread(*i, 0);
+
+    SDL_DestroyCond (idle);
+    SDL_DestroyCond (wake);
+    SDL_DestroyMutex(mutex);
+}
+
+//-----------------------------------------------------------------------------
+
+void etc::worker_pool::push(task *t, batch *b)
+{
+    SDL_LockMutex(mutex);
+    {
+        queue.push_back(entry(t, b));
+        busy++;
+        if (b) b->count++;
+        SDL_CondSignal(wake);
+    }
+    SDL_UnlockMutex(mutex);
+}
+
+void etc::worker_pool::wait(batch *b)
+{
+    SDL_LockMutex(mutex);
+    {
+        // Help drain the queue of the awaited tasks.
+
+        std::deque<entry>::iterator i = queue.begin();
+
+        while (i != queue.end())
+            if (b == 0 || i->second == b)
+            {
+                entry e = *i;
+                queue.erase(i);
+
+                SDL_UnlockMutex(mutex);
+                e.first->run();
+                SDL_LockMutex(mutex);
+
+                finish(e.second);
+                i = queue.begin();
+            }
+            else ++i;
+
+        // Wait for any tasks still running on worker threads.
+
+        while ((b ? b->count : busy) > 0)
+            SDL_CondWait(idle, mutex);
+    }
+    SDL_UnlockMutex(mutex);
+}
+
+// Remove any queued tasks of the given batch. Those already running continue.
+
+void etc::worker_pool::drop(batch *b)
+{
+    SDL_LockMutex(mutex);
+    {
+        std::deque<entry>::iterator i = queue.begin();
+
+        while (i != queue.end())
+            if (i->second == b)
+            {
+                i = queue.erase(i);
+                finish(b);
+            }
+            else ++i;
+    }
+    SDL_UnlockMutex(mutex);
+}
+
+bool etc::worker_pool::done(batch *b)
+{
+    bool d;
+
+    SDL_LockMutex(mutex);
+    {
+        d = (b->count == 0);
+    }
+    SDL_UnlockMutex(mutex);
+
+    return d;
+}
+
+// Account for a completed task. The mutex must be held.
+
+void etc::worker_pool::finish(batch *b)
+{
+    --busy;
+
+    if (b) --b->count;
+
+    if (busy == 0 || (b && b->count == 0))
+        SDL_CondBroadcast(idle);
+}
+
+//-----------------------------------------------------------------------------
+
+int etc::worker_pool::loop(void *data)
+{
+    worker_pool *p = (worker_pool *) data;
+
+    SDL_LockMutex(p->mutex);
+
+    while (!p->stop)
+    {
+        if (p->queue.empty())
+            SDL_CondWait(p->wake, p->mutex);
+        else
+        {
+            entry e = p->queue.front();
+            p->queue.pop_front();
+
+            SDL_UnlockMutex(p->mutex);
+            e.first->run();
+            SDL_LockMutex(p->mutex);
+
+            p->finish(e.second);
+        }
+    }
+
+    SDL_UnlockMutex(p->mutex);
+    return 0;
+}
+
+//-----------------------------------------------------------------------------
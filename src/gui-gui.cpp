@@ -1514,7 +1514,7 @@ void gui::dialog::draw() const
 {
     if (root)
     {
-        glUseProgram(0);
+        ogl::bind_program(0);
 
         glPushAttrib(GL_ENABLE_BIT);
         {
@@ -1524,8 +1524,7 @@ void gui::dialog::draw() const
             glEnable(GL_BLEND);
             glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
-            glActiveTexture(GL_TEXTURE0);
-            glBindTexture(GL_TEXTURE_2D, 0);
+            ogl::bind_texture(GL_TEXTURE_2D, GL_TEXTURE0, 0);
 
             glMatrixMode(GL_TEXTURE);
             glLoadIdentity();
@@ -97,23 +97,21 @@ bool mode::edit::process_point(app::event *E)
 
         if (drag)
         {
-            // If the current drag has produced a previous transform, undo it.
-
-            if (move)
-            {
-                world->undo();
-                move = false;
-            }
-
-            // Apply the transform of the current drag.
+            // Apply the transform of the current drag, amending any previous
+            // transform of this drag. Without one, undo the previous.
 
             mat4 M;
 
             if (xform->point(point_p, point_v, M))
             {
-                world->do_modify(M);
+                world->do_modify(M, move);
                 move = true;
             }
+            else if (move)
+            {
+                world->undo();
+                move = false;
+            }
 
             return true;
         }
@@ -61,6 +61,29 @@ bool mode::play::process_tick(app::event *E)
     return false;
 }
 
+bool mode::play::process_pose(app::event *E)
+{
+    assert(E);
+    assert(world);
+
+    world->play_recv(E);
+
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+
+// Pose the simulated bodies before visibility is determined.
+
+ogl::aabb mode::play::prep(int frusc, const app::frustum *const *frusv)
+{
+    assert(world);
+
+    world->play_pose();
+
+    return mode::prep(frusc, frusv);
+}
+
 //-----------------------------------------------------------------------------
 
 bool mode::play::process_event(app::event *E)
@@ -72,6 +95,7 @@ bool mode::play::process_event(app::event *E)
     case E_START: if (process_start(E)) return true; else break;
     case E_CLOSE: if (process_close(E)) return true; else break;
     case E_TICK:  if (process_tick (E)) return true; else break;
+    case E_POSE:  if (process_pose (E)) return true; else break;
     }
     return mode::process_event(E);
 }
@@ -172,14 +172,23 @@ bool ogl::binding::opaque() const
     return (*color_texture.begin()).second->opaque();
 }
 
+// Determine whether the binding may be drawn by multi-draw in the given mode.
+
+bool ogl::binding::indirect(bool c) const
+{
+    const ogl::program *p = c ? color_program : depth_program;
+
+    return p && p->is_indirect();
+}
+
 //-----------------------------------------------------------------------------
 
-// Apply all program and texture bindings for color or depth mode.
+// Apply all program and texture bindings for color or depth mode.  Only those
+// that differ from the current state reach OpenGL, as ogl::bind_program and
+// ogl::bind_texture cache it.
 
 bool ogl::binding::bind(bool c) const
 {
-    // TODO: Minimize rebindings
-
     unit_texture::const_iterator ti;
 
     if (c)
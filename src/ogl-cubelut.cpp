@@ -111,7 +111,7 @@ void ogl::cubelut::fini()
     {
         assert(object);
 
-        glDeleteTextures(1, &object);
+        ogl::dele_texture(object);
         object = 0;
     }
 }
@@ -299,8 +299,8 @@ void ogl::frame::fini()
     {
         if (buffer) glDeleteFramebuffersEXT(1, &buffer);
 
-        if (color) glDeleteTextures(1, &color);
-        if (depth) glDeleteTextures(1, &depth);
+        if (color) ogl::dele_texture(color);
+        if (depth) ogl::dele_texture(depth);
     }
 }
 
@@ -308,7 +308,7 @@ void ogl::frame::draw()
 {
     glPushAttrib(GL_POLYGON_BIT | GL_ENABLE_BIT | GL_DEPTH_BUFFER_BIT);
     {
-        glUseProgram(0);
+        ogl::bind_program(0);
 
         glDisable(GL_LIGHTING);
         glDisable(GL_BLEND);
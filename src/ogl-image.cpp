@@ -154,7 +154,7 @@ void ogl::image::fini()
 
         // Delete the texture object.
 
-        glDeleteTextures(1, &object);
+        ogl::dele_texture(object);
         object = 0;
     }
 }
@@ -116,6 +116,10 @@ void ogl::irradiance_env::draw(const ogl::binding *bind)
         { 0.0, 0.0, 0.0 }
     };
 
+    static const ogl::program::handle siz ("siz");
+    static const ogl::program::handle loc ("loc");
+    static const ogl::program::handle tst("test");
+
     clip_pool->prep();
     clip_pool->draw_init();
     {
@@ -129,7 +133,7 @@ void ogl::irradiance_env::draw(const ogl::binding *bind)
         // n * n accumulations.
 
         init->bind();
-        init->uniform("siz", vec2(b + 1, b + 1));
+        init->uniform(siz, vec2(b + 1, b + 1));
 
         ping->bind();
         {
@@ -141,10 +145,10 @@ void ogl::irradiance_env::draw(const ogl::binding *bind)
                 {
                     Y[i]->bind(GL_TEXTURE2);
 
-                    init->uniform("loc",  vec2(c, r));
-                    init->uniform("test", vec3(test[i][0],
-                                               test[i][1],
-                                               test[i][2]));
+                    init->uniform(loc, vec2(c, r));
+                    init->uniform(tst, vec3(test[i][0],
+                                            test[i][1],
+                                            test[i][2]));
 
                     clip_node->draw();
                 }
@@ -168,8 +172,8 @@ void ogl::irradiance_env::draw(const ogl::binding *bind)
                 glClear(GL_COLOR_BUFFER_BIT);
                 ping->bind_color(GL_TEXTURE0);
 
-                step->uniform("siz", vec2(double(i) / double(n),
-                                          double(i) / double(n)));
+                step->uniform(siz, vec2(double(i) / double(n),
+                                        double(i) / double(n)));
                 clip_node->draw();
             }
             pong->free();
@@ -32,7 +32,7 @@ ogl::lut::lut(GLsizei w, GLenum T, GLenum fi, GLenum fe, GLenum t) :
 
 ogl::lut::~lut()
 {
-    glDeleteTextures(1, &object);
+    ogl::dele_texture(object);
 }
 
 //-----------------------------------------------------------------------------
@@ -11,6 +11,7 @@
 //  General Public License for more details.
 
 #include <cmath>
+#include <cstring>
 #include <cassert>
 
 #include <etc-vector.hpp>
@@ -20,8 +21,12 @@
 
 //-----------------------------------------------------------------------------
 
-ogl::mesh::mesh(std::string& name) :
-    material(glob->load_binding(name, "default")),
+// A mesh created off the render thread must defer the binding of its material
+// and bind it later, as binding creation touches the OpenGL context.
+
+ogl::mesh::mesh(std::string& name, bool bind) :
+    name(name),
+    material(bind ? glob->load_binding(name, "default") : 0),
     min(std::numeric_limits<GLuint>::max()),
     max(std::numeric_limits<GLuint>::min()),
     dirty_verts(false),
@@ -49,6 +54,12 @@ ogl::mesh::~mesh()
     if (material) glob->free_binding(material);
 }
 
+void ogl::mesh::bind_material()
+{
+    if (material == 0 && !name.empty())
+        material = glob->load_binding(name, "default");
+}
+
 //-----------------------------------------------------------------------------
 
 // The following rendering functions are NOT on the primary display path. They
@@ -168,6 +179,104 @@ void ogl::mesh::calc_tangent()
 
 //-----------------------------------------------------------------------------
 
+// Write the vertex and element data of this mesh to the given buffer in the
+// binary cache format. Return the number of bytes written, or the number to
+// be written if the buffer is null.
+
+size_t ogl::mesh::write(void *p) const
+{
+    const GLuint c[3] = { GLuint(vv.size()), GLuint(faces.size()),
+                                             GLuint(lines.size()) };
+
+    const size_t sc = sizeof (c);
+    const size_t sv = sizeof (GLvec3) * c[0];
+    const size_t sf = sizeof (face)   * c[1];
+    const size_t sl = sizeof (line)   * c[2];
+
+    if (p)
+    {
+        char *q = (char *) p;
+
+        memcpy(q, c, sc); q += sc;
+
+        if (sv) { memcpy(q, &vv.front(), sv); q += sv; }
+        if (sv) { memcpy(q, &nv.front(), sv); q += sv; }
+        if (sv) { memcpy(q, &tv.front(), sv); q += sv; }
+        if (sv) { memcpy(q, &uv.front(), sv); q += sv; }
+        if (sf) { memcpy(q, &faces.front(), sf); q += sf; }
+        if (sl) { memcpy(q, &lines.front(), sl); q += sl; }
+    }
+    return sc + sv * 4 + sf + sl;
+}
+
+// Read vertex and element data in the binary cache format from the given
+// buffer, which ends at the given limit. Return a pointer to the end of the
+// data read, or null if the buffer is too short.
+
+const void *ogl::mesh::read(const void *p, const void *e)
+{
+    const char *q = (const char *) p;
+    const char *z = (const char *) e;
+
+    GLuint c[3];
+
+    if (size_t(z - q) < sizeof (c))
+        return 0;
+
+    memcpy(c, q, sizeof (c)); q += sizeof (c);
+
+    const size_t sv = sizeof (GLvec3) * c[0];
+    const size_t sf = sizeof (face)   * c[1];
+    const size_t sl = sizeof (line)   * c[2];
+
+    if (size_t(z - q) < sv * 4 + sf + sl)
+        return 0;
+
+    // Copy the vertex data.  Note position bounds.
+
+    vv.resize(c[0]);
+    nv.resize(c[0]);
+    tv.resize(c[0]);
+    uv.resize(c[0]);
+
+    if (sv) { memcpy(&vv.front(), q, sv); q += sv; }
+    if (sv) { memcpy(&nv.front(), q, sv); q += sv; }
+    if (sv) { memcpy(&tv.front(), q, sv); q += sv; }
+    if (sv) { memcpy(&uv.front(), q, sv); q += sv; }
+
+    for (GLvec3_v::const_iterator i = vv.begin(); i != vv.end(); ++i)
+        bound.merge(vec3(double(i->v[0]),
+                         double(i->v[1]),
+                         double(i->v[2])));
+
+    // Copy the element data.  Note index range.
+
+    faces.resize(c[1]);
+    lines.resize(c[2]);
+
+    if (sf) { memcpy(&faces.front(), q, sf); q += sf; }
+    if (sl) { memcpy(&lines.front(), q, sl); q += sl; }
+
+    for (face_c i = faces.begin(); i != faces.end(); ++i)
+    {
+        min = std::min(std::min(min, i->i), std::min(i->j, i->k));
+        max = std::max(std::max(max, i->i), std::max(i->j, i->k));
+    }
+    for (line_c i = lines.begin(); i != lines.end(); ++i)
+    {
+        min = std::min(min, std::min(i->i, i->j));
+        max = std::max(max, std::max(i->i, i->j));
+    }
+
+    dirty_verts = true;
+    dirty_faces = true;
+    dirty_lines = true;
+
+    return q;
+}
+
+//-----------------------------------------------------------------------------
+
 void ogl::mesh::add_vert(GLvec3& v, GLvec3& n, GLvec3& u)
 {
     GLvec3 t;
@@ -212,34 +321,128 @@ void ogl::mesh::add_line(GLuint i, GLuint j)
 
 //-----------------------------------------------------------------------------
 
-static void transform_vertex(GLfloat *v, const mat4& M, const GLfloat *u)
+// Vertex pre-transformation is the bulk of the work of a dynamic scene, so it
+// is done in single precision, four lanes at a time where SSE is available.
+// Matrices are given as single precision columns.
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define USE_SSE
+#endif
+
+static void load_columns(GLfloat *C, const mat4& M)
+{
+    for (int i = 0; i < 4; ++i)
+        for (int j = 0; j < 4; ++j)
+            C[j * 4 + i] = GLfloat(M[i][j]);
+}
+
+#ifdef USE_SSE
+
+static void transform_vertices(ogl::GLvec3 *v, const ogl::GLvec3 *u, size_t n,
+                               const GLfloat *C, GLfloat *a, GLfloat *z)
 {
-    // Transform a GL vertex using a double matrix.
+    const __m128 c0 = _mm_loadu_ps(C +  0);
+    const __m128 c1 = _mm_loadu_ps(C +  4);
+    const __m128 c2 = _mm_loadu_ps(C +  8);
+    const __m128 c3 = _mm_loadu_ps(C + 12);
+
+    __m128 lo = _mm_set1_ps(+std::numeric_limits<GLfloat>::max());
+    __m128 hi = _mm_set1_ps(-std::numeric_limits<GLfloat>::max());
 
-    vec4 t = M * vec4(double(u[0]),
-                      double(u[1]),
-                      double(u[2]), 1.0);
+    GLfloat t[4];
 
-    v[0] = GLfloat(t[0] / t[3]);
-    v[1] = GLfloat(t[1] / t[3]);
-    v[2] = GLfloat(t[2] / t[3]);
+    for (size_t i = 0; i < n; ++i)
+    {
+        __m128 p = _mm_add_ps(_mm_add_ps(_mm_mul_ps(c0, _mm_set1_ps(u[i].v[0])),
+                                         _mm_mul_ps(c1, _mm_set1_ps(u[i].v[1]))),
+                              _mm_add_ps(_mm_mul_ps(c2, _mm_set1_ps(u[i].v[2])),
+                                         c3));
+
+        p  = _mm_div_ps(p, _mm_shuffle_ps(p, p, _MM_SHUFFLE(3, 3, 3, 3)));
+        lo = _mm_min_ps(lo, p);
+        hi = _mm_max_ps(hi, p);
+
+        _mm_storeu_ps(t, p);
+
+        v[i].v[0] = t[0];
+        v[i].v[1] = t[1];
+        v[i].v[2] = t[2];
+    }
+
+    _mm_storeu_ps(t, lo); a[0] = t[0]; a[1] = t[1]; a[2] = t[2];
+    _mm_storeu_ps(t, hi); z[0] = t[0]; z[1] = t[1]; z[2] = t[2];
 }
 
-static void transform_normal(GLfloat *v, const mat4& M, const GLfloat *u)
+static void transform_normals(ogl::GLvec3 *v, const ogl::GLvec3 *u, size_t n,
+                              const GLfloat *C)
 {
-    // Transform a GL vertex using a double matrix.
+    const __m128 c0 = _mm_loadu_ps(C +  0);
+    const __m128 c1 = _mm_loadu_ps(C +  4);
+    const __m128 c2 = _mm_loadu_ps(C +  8);
 
-    vec4 t = M * vec4(double(u[0]),
-                      double(u[1]),
-                      double(u[2]), 0.0);
+    GLfloat t[4];
 
-    v[0] = GLfloat(t[0]);
-    v[1] = GLfloat(t[1]);
-    v[2] = GLfloat(t[2]);
+    for (size_t i = 0; i < n; ++i)
+    {
+        __m128 p = _mm_add_ps(_mm_add_ps(_mm_mul_ps(c0, _mm_set1_ps(u[i].v[0])),
+                                         _mm_mul_ps(c1, _mm_set1_ps(u[i].v[1]))),
+                                         _mm_mul_ps(c2, _mm_set1_ps(u[i].v[2])));
+        _mm_storeu_ps(t, p);
+
+        v[i].v[0] = t[0];
+        v[i].v[1] = t[1];
+        v[i].v[2] = t[2];
+    }
 }
 
+#else
+
+static void transform_vertices(ogl::GLvec3 *v, const ogl::GLvec3 *u, size_t n,
+                               const GLfloat *C, GLfloat *a, GLfloat *z)
+{
+    a[0] = a[1] = a[2] = +std::numeric_limits<GLfloat>::max();
+    z[0] = z[1] = z[2] = -std::numeric_limits<GLfloat>::max();
+
+    for (size_t i = 0; i < n; ++i)
+    {
+        const GLfloat x = u[i].v[0];
+        const GLfloat y = u[i].v[1];
+        const GLfloat w = u[i].v[2];
+
+        const GLfloat k = C[3] * x + C[7] * y + C[11] * w + C[15];
+
+        for (int j = 0; j < 3; ++j)
+        {
+            v[i].v[j] = (C[j] * x + C[j + 4] * y + C[j + 8] * w + C[j + 12]) / k;
+
+            a[j] = std::min(a[j], v[i].v[j]);
+            z[j] = std::max(z[j], v[i].v[j]);
+        }
+    }
+}
+
+static void transform_normals(ogl::GLvec3 *v, const ogl::GLvec3 *u, size_t n,
+                              const GLfloat *C)
+{
+    for (size_t i = 0; i < n; ++i)
+    {
+        const GLfloat x = u[i].v[0];
+        const GLfloat y = u[i].v[1];
+        const GLfloat w = u[i].v[2];
+
+        for (int j = 0; j < 3; ++j)
+            v[i].v[j] = C[j] * x + C[j + 4] * y + C[j + 8] * w;
+    }
+}
+
+#endif
+
 //-----------------------------------------------------------------------------
 
+// This may be called from a worker thread. It touches only this cache mesh and
+// reads only that source mesh.
+
 void ogl::mesh::cache_verts(const ogl::mesh *that, const mat4& M,
                                                    const mat4& I, int id)
 {
@@ -254,18 +457,26 @@ void ogl::mesh::cache_verts(const ogl::mesh *that, const mat4& M,
 
     bound = aabb();
 
-    for (size_t i = 0; i < n; ++i)
+    if (n)
     {
-        transform_vertex(vv[i].v,           M,  that->vv[i].v);
-        transform_normal(nv[i].v, transpose(I), that->nv[i].v);
-        transform_normal(tv[i].v, transpose(I), that->tv[i].v);
+        GLfloat A[16], B[16], a[3], z[3];
+
+        load_columns(A,           M);
+        load_columns(B, transpose(I));
 
-        bound.merge(vec3(double(vv[i].v[0]),
-                         double(vv[i].v[1]),
-                         double(vv[i].v[2])));
+        transform_vertices(&vv.front(), &that->vv.front(), n, A, a, z);
+        transform_normals (&nv.front(), &that->nv.front(), n, B);
+        transform_normals (&tv.front(), &that->tv.front(), n, B);
+
+        bound.merge(vec3(double(a[0]), double(a[1]), double(a[2])));
+        bound.merge(vec3(double(z[0]), double(z[1]), double(z[2])));
+    }
 
-        // Handy trick: Store the unit ID in the texture coordinate.
+    // Handy trick: Store the unit ID in the texture coordinate.  Note: packed
+    // vertices split it in two.  See GLpack.
 
+    for (size_t i = 0; i < n; ++i)
+    {
         uv[i].v[0] = that->uv[i].v[0];
         uv[i].v[1] = that->uv[i].v[1];
         uv[i].v[2] = GLfloat(id);
@@ -354,6 +565,107 @@ void ogl::mesh::buffv(const GLfloat *v,
     dirty_verts = false;
 }
 
+//-----------------------------------------------------------------------------
+
+static GLuint pack_snorm(const GLfloat *v)
+{
+    // Pack a vector as signed-normalized 10:10:10:2, reversed.
+
+    GLuint p = 0;
+
+    for (int i = 0; i < 3; ++i)
+    {
+        const GLfloat k = std::max(-1.0f, std::min(1.0f, v[i]));
+        const GLint   d = GLint(floorf(k * 511.0f + 0.5f));
+
+        p |= (GLuint(d) & 0x3FF) << (i * 10);
+    }
+    return p;
+}
+
+static GLushort pack_half(GLfloat f)
+{
+    // Convert a float to a half, rounding to nearest.
+
+    union { GLfloat f; GLuint u; } x;
+
+    x.f = f;
+
+    const GLuint s = (x.u >> 16) & 0x8000;
+    const GLint  e = GLint((x.u >> 23) & 0xFF) - 127 + 15;
+    const GLuint m =  x.u & 0x7FFFFF;
+
+    if (((x.u >> 23) & 0xFF) == 0xFF)
+        return GLushort(s | 0x7C00 | (m ? 0x200 : 0));     // Inf or NaN
+    if (e >= 31)
+        return GLushort(s | 0x7C00);                        // Overflow
+    if (e <= 0)
+    {
+        if (e < -10) return GLushort(s);                    // Underflow
+
+        const GLuint n = m | 0x800000;                      // Subnormal
+        const GLuint k = GLuint(14 - e);
+
+        return GLushort(s | ((n + (1 << (k - 1))) >> k));
+    }
+    return GLushort(s + (GLuint(e) << 10) + ((m + 0x1000) >> 13));
+}
+
+// Pack n vertices from the planar caches into the given destination.
+
+static void pack_verts(ogl::GLpack *d, size_t n, const ogl::GLvec3_v& vv,
+                                                 const ogl::GLvec3_v& nv,
+                                                 const ogl::GLvec3_v& tv,
+                                                 const ogl::GLvec3_v& uv)
+{
+    for (size_t i = 0; i < n; ++i)
+    {
+        const GLuint id = GLuint(uv[i].v[2]);
+
+        d[i].v[0] = vv[i].v[0];
+        d[i].v[1] = vv[i].v[1];
+        d[i].v[2] = vv[i].v[2];
+        d[i].n    = pack_snorm(nv[i].v);
+        d[i].t    = pack_snorm(tv[i].v);
+        d[i].u[0] = pack_half(uv[i].v[0]);
+        d[i].u[1] = pack_half(uv[i].v[1]);
+        d[i].u[2] = pack_half(GLfloat(id % 2048));
+        d[i].u[3] = pack_half(GLfloat(id / 2048 + 1));
+    }
+}
+
+void ogl::mesh::buffp(const GLpack *p)
+{
+    // Pack all cached vertex data directly into the mapped range of the bound
+    // array buffer.  Lacking a mapping, pack locally and copy.
+
+    if (dirty_verts && !vv.empty())
+    {
+        const size_t     n = vv.size();
+        const GLsizeiptr s = GLsizeiptr(n * sizeof (GLpack));
+
+        GLpack *d = 0;
+
+        if (glMapBufferRange)
+            d = (GLpack *) glMapBufferRange(GL_ARRAY_BUFFER, GLintptr(p), s,
+                                            GL_MAP_WRITE_BIT |
+                                            GL_MAP_INVALIDATE_RANGE_BIT);
+        if (d)
+        {
+            pack_verts(d, n, vv, nv, tv, uv);
+            glUnmapBuffer(GL_ARRAY_BUFFER);
+        }
+        else
+        {
+            GLpack_v pv(n);
+
+            pack_verts(&pv.front(), n, vv, nv, tv, uv);
+            buffer(GLintptr(p), s, &pv.front());
+        }
+    }
+    dirty_verts = false;
+}
+
 void ogl::mesh::buffe(const GLuint *e)
 {
     // Copy all cached index data to the bound element array buffer object.
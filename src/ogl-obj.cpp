@@ -11,16 +11,23 @@
 //  General Public License for more details.
 
 #include <cstdlib>
+#include <cstring>
 #include <iostream>
 
+#include <etc-task.hpp>
 #include <ogl-obj.hpp>
 #include <ogl-aabb.hpp>
 #include <app-data.hpp>
+#include <app-file.hpp>
 
 //-----------------------------------------------------------------------------
 
 static ogl::GLvec3 z3;
 
+// Files smaller than this are parsed by the calling thread alone.
+
+#define MIN_PARALLEL_BYTES (1 << 20)
+
 //-----------------------------------------------------------------------------
 
 void obj::obj::center()
@@ -90,17 +97,22 @@ static const char *scannl(const char *p)
         }
 }
 
+static bool isgap(char c)
+{
+    return (c == ' ' || c == '\t' || c == '\r');
+}
+
 static const char *scanword(const char *p, std::string& word)
 {
-    // Scan for the beginning of a word.
+    // Scan for the beginning of a word within the current line.
 
-    const char *b = p + 6;
-    while ( isspace(*b)) b++;
+    const char *b = p;
+    while (isgap(*b)) b++;
 
     // Scan for the end of the word.
 
     const char *e = b;
-    while (!isspace(*e)) e++;
+    while (*e && !isspace(*e)) e++;
 
     // Move the point forward.
 
@@ -111,296 +123,628 @@ static const char *scanword(const char *p, std::string& word)
 
 //-----------------------------------------------------------------------------
 
-const char *obj::obj::read_fi(const char *p, int& i)
+// Parse a decimal integer, giving zero and leaving the point unmoved if none.
+
+static const char *scanint(const char *p, int& i)
 {
-    // Read the next index set specification.
+    const char *q = p;
+    bool        n = false;
 
-    int  vi = 0;
-    int  si = 0;
-    int  ni = 0;
-    char *q;
+    while (isgap(*q)) q++;
 
-    if ((vi = int(strtol(p, &q, 0))))
+    if      (*q == '-') { n = true; q++; }
+    else if (*q == '+') {           q++; }
+
+    if ('0' <= *q && *q <= '9')
     {
-        p = q;
+        for (i = 0; '0' <= *q && *q <= '9'; q++)
+            i = i * 10 + (*q - '0');
 
-        if (*p == '/') { si = int(strtol(++p, &q, 0)); p = q; }
-        if (*p == '/') { ni = int(strtol(++p, &q, 0)); p = q; }
+        if (n) i = -i;
+        return q;
+    }
+    else
+    {
+        i = 0;
+        return p;
+    }
+}
 
-        // Convert face indices to vector cache indices.
+// Parse a floating point number.  Mantissas of up to 15 significant digits
+// scaled by powers of ten up to 22 are exactly representable, so the single
+// rounding of the product or quotient gives the same result as strtod. All
+// other values, including infinities and NaNs, are deferred to strtod.
 
-        if (vi < 0) vi += vv.size(); else vi--;
-        if (si < 0) si += sv.size(); else si--;
-        if (ni < 0) ni += nv.size(); else ni--;
+static const double powers[] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
 
-        // Return any prior occurrance of this set of cache indices.
+static const char *scanfloat(const char *p, double& d)
+{
+    const char *q = p;
+    bool        n = false;
 
-        for (i = ii[vi]; i != -1; i = is[i].ii)
-            if (is[i].vi == vi &&
-                is[i].si == si &&
-                is[i].ni == ni) return p;
+    while (isgap(*q)) q++;
 
-        // These indices are new.  Add a new vertex and link a new index set.
+    const char *s = q;
 
-        i = int(meshes.back()->count_verts());
+    if      (*q == '-') { n = true; q++; }
+    else if (*q == '+') {           q++; }
 
-        meshes.back()->add_vert((vi < 0) ? z3 : vv[vi],
-                                (ni < 0) ? z3 : nv[ni],
-                                (si < 0) ? z3 : sv[si]);
+    double m = 0;
+    int    c = 0;
+    int    e = 0;
+    bool   k = false;
 
-        is.push_back(iset(vi, si, ni, ii[vi]));
+    // Accumulate the integer and fractional digits, noting significance.
 
-        ii[vi] = i;
+    for (; '0' <= *q && *q <= '9'; q++, k = true)
+        if (c || *q != '0')
+        {
+            if (c < 16) m = m * 10 + (*q - '0'); else e++;
+            c++;
+        }
+
+    if (*q == '.')
+    {
+        for (q++; '0' <= *q && *q <= '9'; q++, k = true)
+            if (c || *q != '0')
+            {
+                if (c < 16) { m = m * 10 + (*q - '0'); e--; }
+                c++;
+            }
+            else e--;
     }
-    else i = -1;
 
-    return p;
+    // Without digits, this may yet be an infinity or NaN.
+
+    if (!k && (isspace(*s) || !*s))
+    {
+        d = 0;
+        return p;
+    }
+    if (!k)
+    {
+        char *r;
+
+        d = strtod(s, &r);
+        return (r == s) ? p : r;
+    }
+
+    // Accumulate the exponent.
+
+    if (*q == 'e' || *q == 'E')
+    {
+        int x;
+        const char *r = scanint(q + 1, x);
+
+        if (r != q + 1 && !isgap(q[1]))
+        {
+            e += x;
+            q  = r;
+        }
+    }
+
+    // Take the fast path if possible.
+
+    if (c <= 15 && -22 <= e && e <= 22)
+    {
+        d = (e < 0) ? m / powers[-e] : m * powers[e];
+        if (n) d = -d;
+        return q;
+    }
+    else
+    {
+        char *r;
+
+        d = strtod(s, &r);
+        return r;
+    }
 }
 
-const char *obj::obj::read_li(const char *p, int& i)
-{
-    // Read the next index set specification.
+//-----------------------------------------------------------------------------
 
-    int  vi = 0;
-    int  si = 0;
-    char *q;
+// Element and material records are emitted by the parallel pass as a stream
+// of integers and merged into meshes in file order.
 
-    if ((vi = int(strtol(p, &q, 0))))
+enum { op_use = -1, op_f = -2, op_l = -3 };
+
+namespace obj
+{
+    class chunk : public etc::task
     {
-        p = q;
+    public:
 
-        if (*p == '/') { si = int(strtol(++p, &q, 0)); p = q; }
+        chunk(const char *b, const char *e) : b(b), e(e), counting(true),
+            vc(0), sc(0), nc(0), lc(0), scaled(false), last(1),
+            vb(0), sb(0), nb(0), scale(1), vv(0), sv(0), nv(0) { }
 
-        // Convert face indices to vector cache indices.
+        void run() { if (counting) count(); else parse(); }
 
-        if (vi < 0) vi += vv.size(); else vi--;
-        if (si < 0) si += sv.size(); else si--;
+        // Line-aligned extent of this chunk.
 
-        // Return any prior occurrance of this set of cache indices.
+        const char *b;
+        const char *e;
+        bool counting;
 
-        for (i = ii[vi]; i != -1; i = is[i].ii)
-            if (is[i].vi == vi &&
-                is[i].si == si) return p;
+        // First pass results: element counts and the last unit scale.
 
-        // These indices are new.  Add a new vertex and link a new index set.
+        int  vc;
+        int  sc;
+        int  nc;
+        int  lc;
+        bool   scaled;
+        double last;
 
-        i = int(meshes.back()->count_verts());
+        // Second pass inputs: vector cache bases and the inherited scale.
 
-        meshes.back()->add_vert((vi < 0) ? z3 : vv[vi], z3,
-                                (si < 0) ? z3 : sv[si]);
+        int vb;
+        int sb;
+        int nb;
+        double scale;
 
-        is.push_back(iset(vi, si, -1, ii[vi]));
+        ogl::GLvec3_d *vv;
+        ogl::GLvec3_d *sv;
+        ogl::GLvec3_d *nv;
 
-        ii[vi] = i;
-    }
-    else i = -1;
+        // Second pass results.
 
-    return p;
+        std::vector<int>         ops;
+        std::vector<std::string> names;
+
+    private:
+
+        const char *read_c (const char *, double&, bool&);
+        const char *read_fi(const char *, int&, int&, int&);
+
+        void count();
+        void parse();
+    };
 }
 
-//-----------------------------------------------------------------------------
+// Read a comment, noting a unit specification.
 
-const char *obj::obj::read_use(const char *p)
+const char *obj::chunk::read_c(const char *p, double& s, bool& b)
 {
-    std::string name;
+    std::string key;
+    std::string val;
 
-    // Create a new mesh using the named material.
+    p = scanword(scanword(p + 1, key), val);
+
+    if (key == "unit")
+    {
+        s = scale_to_meters(val);
+        b = true;
+    }
+    return p;
+}
 
-    p = scanword(p, name);
+// Read one index set, resolving relative indices against the counts so far.
+// Return null at the end of the list.
 
-    meshes.push_back(new ogl::mesh(name));
+const char *obj::chunk::read_fi(const char *p, int& vi, int& si, int& ni)
+{
+    const char *q;
+
+    if ((q = scanint(p, vi)) != p && vi)
+    {
+        p  = q;
+        si = 0;
+        ni = 0;
 
-    // Disallow vertex optimization across mesh boundaries?
+        if (*p == '/') p = scanint(++p, si);
+        if (*p == '/') p = scanint(++p, ni);
 
-    for (indx_v::iterator i = ii.begin(); i != ii.end(); ++i)
-        *i = -1;
+        if (vi < 0) vi += vb + vc; else vi--;
+        if (si < 0) si += sb + sc; else si--;
+        if (ni < 0) ni += nb + nc; else ni--;
 
-    return scannl(p);
+        return p;
+    }
+    return 0;
 }
 
-//-----------------------------------------------------------------------------
+// First pass: count the vectors in this chunk and find any unit comments.
 
-const char *obj::obj::read_c(const char *p)
+void obj::chunk::count()
 {
-    // TODO: Check for a vert/face count comments and reserve vectors.
-
-    while (token_c(p))
+    for (const char *p = b; p < e; )
     {
-        std::string key;
-        std::string val;
+        if      (token_c (p)) p = read_c(p, last, scaled);
+        else if (token_f (p)) ;
+        else if (token_l (p)) lc++;
+        else if (token_v (p)) vc++;
+        else if (token_vt(p)) sc++;
+        else if (token_vn(p)) nc++;
 
-        p = scannl(scanword(scanword(p, key), val));
-
-        if (key == "unit") scale = scale_to_meters(val);
+        p = scannl(p);
     }
-    return p;
+    counting = false;
 }
 
-const char *obj::obj::read_v(const char *p)
+// Second pass: parse vectors directly into the shared vector caches and
+// encode elements and material changes for the merge.
+
+void obj::chunk::parse()
 {
-    ogl::GLvec3 v;
-    char       *q;
+    const int V = vc;
+    const int S = sc;
+    const int N = nc;
+
+    double x;
+    double y;
+    double z;
+    bool   u;
 
-    // Process a sequence of vertex positions.
+    vc = sc = nc = 0;
 
-    while (token_v(p))
+    for (const char *p = b; p < e; p = scannl(p))
     {
-        v.v[0] = GLfloat(scale * strtod(p + 1, &q)); p = q;
-        v.v[1] = GLfloat(scale * strtod(p,     &q)); p = q;
-        v.v[2] = GLfloat(scale * strtod(p,     &q)); p = scannl(q);
+        if (token_c(p))
+        {
+            p = read_c(p, scale, u);
+        }
+        else if (token_v(p) && vc < V)
+        {
+            p = scanfloat(p + 1, x);
+            p = scanfloat(p,     y);
+            p = scanfloat(p,     z);
+
+            ogl::GLvec3& v = (*vv)[vb + vc++];
+
+            v.v[0] = GLfloat(scale * x);
+            v.v[1] = GLfloat(scale * y);
+            v.v[2] = GLfloat(scale * z);
+        }
+        else if (token_vt(p) && sc < S)
+        {
+            p = scanfloat(p + 2, x);
+            p = scanfloat(p,     y);
+
+            ogl::GLvec3& v = (*sv)[sb + sc++];
+
+            v.v[0] = GLfloat(x);
+            v.v[1] = GLfloat(y);
+            v.v[2] = 0.f;
+        }
+        else if (token_vn(p) && nc < N)
+        {
+            p = scanfloat(p + 2, x);
+            p = scanfloat(p,     y);
+            p = scanfloat(p,     z);
+
+            ogl::GLvec3& v = (*nv)[nb + nc++];
+
+            v.v[0] = GLfloat(x);
+            v.v[1] = GLfloat(y);
+            v.v[2] = GLfloat(z);
+        }
+        else if (token_f(p) || token_l(p))
+        {
+            const bool f = token_f(p);
+
+            // Encode the index sets of a face or line, prefixed by a count.
+
+            ops.push_back(f ? op_f : op_l);
+            ops.push_back(0);
 
-        vv.push_back( v);
-        ii.push_back(-1);
+            const size_t k = ops.size() - 1;
+            const char  *q;
+            int vi, si, ni;
+
+            for (p++; (q = read_fi(p, vi, si, ni)); p = q)
+            {
+                ops.push_back(vi);
+                ops.push_back(si);
+                ops.push_back(f ? ni : -1);
+                ops[k]++;
+            }
+        }
+        else if (token_use(p))
+        {
+            std::string name;
+
+            p = scanword(p + 6, name);
+
+            ops.push_back(op_use);
+            ops.push_back(int(names.size()));
+            names.push_back(name);
+        }
     }
+}
 
-    return p;
+//-----------------------------------------------------------------------------
+
+void obj::iset_table::clear()
+{
+    // Retire all entries at once by advancing the generation.
+
+    if (++gen == 0)
+    {
+        for (std::vector<iset>::iterator i = slots.begin(); i != slots.end(); ++i)
+            i->gen = 0;
+        gen = 1;
+    }
+    used = 0;
 }
 
-const char *obj::obj::read_vt(const char *p)
+int& obj::iset_table::find(int vi, int si, int ni)
 {
-    ogl::GLvec3 v;
-    char       *q;
+    // Keep the load factor below 3/4.
+
+    if (4 * (used + 1) > 3 * slots.size())
+        grow();
+
+    const size_t m = slots.size() - 1;
 
-    // Process a sequence of vertex texture coordinaces.
+    size_t k = (size_t(vi) * 73856093u ^
+                size_t(si) * 19349663u ^
+                size_t(ni) * 83492791u) & m;
 
-    while (token_vt(p))
+    // Probe for the index set, claiming an empty slot if it is new.
+
+    while (slots[k].gen == gen)
     {
-        v.v[0] = GLfloat(strtod(p + 2, &q)); p = q;
-        v.v[1] = GLfloat(strtod(p,     &q)); p = scannl(q);
-        v.v[2] = 0.f;
+        if (slots[k].vi == vi && slots[k].si == si && slots[k].ni == ni)
+            return slots[k].i;
 
-        sv.push_back(v);
+        k = (k + 1) & m;
     }
 
-    return p;
+    slots[k].vi  = vi;
+    slots[k].si  = si;
+    slots[k].ni  = ni;
+    slots[k].i   = -1;
+    slots[k].gen = gen;
+
+    used++;
+
+    return slots[k].i;
 }
 
-const char *obj::obj::read_vn(const char *p)
+void obj::iset_table::grow()
 {
-    ogl::GLvec3 v;
-    char       *q;
+    std::vector<iset> prev;
 
-    // Process a sequence of vertex normals.
+    // Double the table and reinsert the current generation.
 
-    while (token_vn(p))
-    {
-        v.v[0] = GLfloat(strtod(p + 2, &q)); p = q;
-        v.v[1] = GLfloat(strtod(p,     &q)); p = q;
-        v.v[2] = GLfloat(strtod(p,     &q)); p = scannl(q);
+    prev.swap(slots);
+    slots.resize(std::max(prev.size() * 2, size_t(4096)));
 
-        nv.push_back(v);
-    }
+    for (size_t i = 0; i < slots.size(); ++i)
+        slots[i].gen = 0;
 
-    return p;
+    used = 0;
+
+    for (std::vector<iset>::iterator i = prev.begin(); i != prev.end(); ++i)
+        if (i->gen == gen)
+            find(i->vi, i->si, i->ni) = i->i;
 }
 
 //-----------------------------------------------------------------------------
 
-const char *obj::obj::read_f(const char *p)
+const int *obj::obj::merge_use(const int *p, const chunk& c)
+{
+    // Create a new mesh using the named material.
+
+    std::string name = c.names[p[1]];
+
+    meshes.push_back(new ogl::mesh(name, bind));
+
+    // Disallow vertex optimization across mesh boundaries.
+
+    fi.clear();
+    li.clear();
+
+    return p + 2;
+}
+
+const int *obj::obj::merge_f(const int *p)
 {
+    const int n = p[1];
+
     // Make sure we've got a mesh to receive faces.
 
     if (meshes.empty())
         meshes.push_back(new ogl::mesh());
 
-    // Process a sequence of face definitions.
+    // Convert index sets to vertex indices, adding each new one.
 
-    while (token_f(p))
+    iv.clear();
+
+    for (p += 2; int(iv.size()) < n; p += 3)
     {
-        std::vector<GLuint> iv;
+        const int vi = p[0];
+        const int si = p[1];
+        const int ni = p[2];
+
+        int& i = fi.find(vi, si, ni);
 
-        p++;
+        if (i < 0)
+        {
+            ogl::GLvec3 v = (0 <= vi && vi < int(vv.size())) ? vv[vi] : z3;
+            ogl::GLvec3 s = (0 <= si && si < int(sv.size())) ? sv[si] : z3;
+            ogl::GLvec3 t = (0 <= ni && ni < int(nv.size())) ? nv[ni] : z3;
 
-        // Scan the string, converting index sets to vertex indices.
+            i = int(meshes.back()->count_verts());
 
-        int i;
+            meshes.back()->add_vert(v, t, s);
 
-        while ((p = read_fi(p, i)) && i >= 0)
-            iv.push_back(GLuint(i));
+            // Lines reuse the most recent vertex with matching position and
+            // texture coordinate, regardless of normal.
 
-        p = scannl(p);
+            if (lines) li.find(vi, si, 0) = i;
+        }
+        iv.push_back(GLuint(i));
+    }
 
-        // Convert our N new vertex indices into N-2 new triangles.
+    // Convert our N new vertex indices into N-2 new triangles.
 
-        int n = int(iv.size());
+    for (int i = 0; i < n - 2; ++i)
+        meshes.back()->add_face(iv[0], iv[i + 1], iv[i + 2]);
 
-        for (i = 0; i < n - 2; ++i)
-            meshes.back()->add_face(iv[0], iv[i + 1], iv[i + 2]);
-    }
     return p;
 }
 
-const char *obj::obj::read_l(const char *p)
+const int *obj::obj::merge_l(const int *p)
 {
+    const int n = p[1];
+
     // Make sure we've got a mesh to receive lines.
 
     if (meshes.empty())
         meshes.push_back(new ogl::mesh());
 
-    // Process a sequence of line definitions.
+    // Convert index sets to vertex indices, adding each new one.
+
+    iv.clear();
 
-    while (token_l(p))
+    for (p += 2; int(iv.size()) < n; p += 3)
     {
-        std::vector<GLuint> iv;
+        const int vi = p[0];
+        const int si = p[1];
 
-        p++;
+        int& i = li.find(vi, si, 0);
 
-        // Scan the string, converting index sets to vertex indices.
+        if (i < 0)
+        {
+            ogl::GLvec3 v = (0 <= vi && vi < int(vv.size())) ? vv[vi] : z3;
+            ogl::GLvec3 s = (0 <= si && si < int(sv.size())) ? sv[si] : z3;
 
-        int i;
+            i = int(meshes.back()->count_verts());
 
-        while ((p = read_li(p, i)) && i >= 0)
-            iv.push_back(GLuint(i));
+            meshes.back()->add_vert(v, z3, s);
 
-        p = scannl(p);
+            fi.find(vi, si, -1) = i;
+        }
+        iv.push_back(GLuint(i));
+    }
 
-        // Convert our N new vertex indices into N-1 new lines.
+    // Convert our N new vertex indices into N-1 new lines.
 
-        int n = int(iv.size());
+    for (int i = 0; i < n - 1; ++i)
+        meshes.back()->add_line(iv[i], iv[i + 1]);
 
-        for (i = 0; i < n - 1; ++i)
-            meshes.back()->add_line(iv[i], iv[i + 1]);
-    }
     return p;
 }
 
 //-----------------------------------------------------------------------------
 
-obj::obj::obj(std::string name, bool c) : scale(1)
+obj::obj::obj(std::string name, bool c, bool b) : bind(b)
 {
-    // Reserving the vector caches gives only about about 2% improvement.
-/*
-    vv.reserve(1024 * 1024);
-    sv.reserve(1024 * 1024);
-    nv.reserve(1024 * 1024);
-    ii.reserve(1024 * 1024);
-    is.reserve(1024 * 1024);
-*/
     // Initialize the input file.
 
-    const char *p = (const char *) ::data->load(name);
+    size_t      n = 0;
+    const char *p = (const char *) ::data->load(name, &n);
+    const char *z = p + strlen(p);
+
+    // Split the file into line-aligned chunks, one per thread if worthwhile.
+
+    int m = 1;
+
+    if (::workers && ::workers->size() && n > MIN_PARALLEL_BYTES)
+        m = std::min(::workers->size() + 1, int(n / (MIN_PARALLEL_BYTES / 4)));
+
+    chunk_v    chunks;
+    etc::batch batch;
+
+    for (int i = 0; i < m; ++i)
+    {
+        const char *b = chunks.empty() ? p : chunks.back().e;
+        const char *e = (i == m - 1) ? z : p + (z - p) * (i + 1) / m;
+
+        if (e < b) e = b;
+        if (e < z) e = scannl(e);
+
+        chunks.push_back(chunk(b, e));
+    }
+
+    // Count the vectors of each chunk and find any unit comments.
+
+    if (m > 1)
+    {
+        for (chunk_v::iterator i = chunks.begin(); i != chunks.end(); ++i)
+            ::workers->push(&(*i), &batch);
+        ::workers->wait(&batch);
+    }
+    else chunks.front().run();
+
+    // Allocate the vector caches and give each chunk its base and scale.
+
+    int    vc = 0;
+    int    sc = 0;
+    int    nc = 0;
+    double s  = 1;
+
+    for (chunk_v::iterator i = chunks.begin(); i != chunks.end(); ++i)
+    {
+        i->vb    = vc;
+        i->sb    = sc;
+        i->nb    = nc;
+        i->scale = s;
+
+        vc += i->vc;
+        sc += i->sc;
+        nc += i->nc;
+
+        if (i->scaled) s = i->last;
+    }
+
+    lines = false;
+
+    for (chunk_v::iterator i = chunks.begin(); i != chunks.end(); ++i)
+        if (i->lc) lines = true;
+
+    vv.resize(vc);
+    sv.resize(sc);
+    nv.resize(nc);
 
-    // Process data until the end of the file is reached.
+    // Chunks index the caches, which need not be contiguous.  Each writes only
+    // its own range of the pre-sized caches, so none is resized concurrently.
 
-    while (*p)
+    for (chunk_v::iterator i = chunks.begin(); i != chunks.end(); ++i)
     {
-        if      (token_c  (p)) p = read_c  (p);
-        else if (token_f  (p)) p = read_f  (p);
-        else if (token_l  (p)) p = read_l  (p);
-        else if (token_v  (p)) p = read_v  (p);
-        else if (token_vt (p)) p = read_vt (p);
-        else if (token_vn (p)) p = read_vn (p);
-        else if (token_use(p)) p = read_use(p);
-        else                   p = scannl(p);
+        i->vv = &vv;
+        i->sv = &sv;
+        i->nv = &nv;
+    }
+
+    // Parse all chunks.
+
+    if (m > 1)
+    {
+        for (chunk_v::iterator i = chunks.begin(); i != chunks.end(); ++i)
+            ::workers->push(&(*i), &batch);
+        ::workers->wait(&batch);
+    }
+    else chunks.front().run();
+
+    // Merge elements into meshes in file order.
+
+    for (chunk_v::iterator i = chunks.begin(); i != chunks.end(); ++i)
+    {
+        const int *b = i->ops.empty() ? 0 : &i->ops.front();
+        const int *e = b + i->ops.size();
+
+        for (const int *q = b; q < e; )
+            switch (*q)
+            {
+            case op_use: q = merge_use(q, *i); break;
+            case op_f:   q = merge_f  (q);     break;
+            case op_l:   q = merge_l  (q);     break;
+            default:     q = e;
+            }
     }
 
 	// Release the cached data.
 
-    vv.clear();
-    sv.clear();
-    nv.clear();
-    ii.clear();
-    is.clear();
+    ogl::GLvec3_d().swap(vv);
+    ogl::GLvec3_d().swap(sv);
+    ogl::GLvec3_d().swap(nv);
+
+    fi = iset_table();
+    li = iset_table();
 
     // Release the open data file.
 
@@ -423,4 +767,3 @@ obj::obj::~obj()
 }
 
 //-----------------------------------------------------------------------------
-
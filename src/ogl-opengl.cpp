@@ -27,6 +27,12 @@ bool ogl::has_depth_stencil;
 bool ogl::has_multisample;
 bool ogl::has_anisotropic;
 bool ogl::has_s3tc;
+bool ogl::has_rgtc;
+bool ogl::has_bptc;
+bool ogl::has_packed_verts;
+bool ogl::has_pixel_buffer;
+bool ogl::has_multi_draw;
+bool ogl::has_timer_query;
 
 int  ogl::max_lights;
 int  ogl::max_anisotropy;
@@ -34,6 +40,7 @@ int  ogl::max_anisotropy;
 bool ogl::do_texture_compression;
 bool ogl::do_hdr_tonemap;
 bool ogl::do_hdr_bloom;
+bool ogl::do_multi_draw;
 
 //-----------------------------------------------------------------------------
 
@@ -45,6 +52,7 @@ static void init_opt()
     ogl::do_texture_compression = false;
     ogl::do_hdr_tonemap         = false;
     ogl::do_hdr_bloom           = false;
+    ogl::do_multi_draw          = false;
 
     // Query GL capabilities.
 
@@ -52,6 +60,17 @@ static void init_opt()
 	ogl::has_multisample   = glewIsSupported("GL_multisample")                    ? true : false;
 	ogl::has_anisotropic   = glewIsSupported("GL_EXT_texture_filter_anisotropic") ? true : false;
 	ogl::has_s3tc          = glewIsSupported("GL_EXT_texture_compression_s3tc")   ? true : false;
+    ogl::has_rgtc          = glewIsSupported("GL_ARB_texture_compression_rgtc")   ? true : false;
+    ogl::has_bptc          = glewIsSupported("GL_ARB_texture_compression_bptc")   ? true : false;
+	ogl::has_packed_verts  = glewIsSupported("GL_ARB_vertex_type_2_10_10_10_rev "
+	                                         "GL_ARB_half_float_vertex")          ? true : false;
+    ogl::has_pixel_buffer  = glewIsSupported("GL_ARB_pixel_buffer_object")        ? true : false;
+    ogl::has_multi_draw    = glewIsSupported("GL_ARB_multi_draw_indirect "
+                                             "GL_ARB_shader_storage_buffer_object "
+                                             "GL_ARB_shader_draw_parameters "
+                                             "GL_ARB_base_instance")
+                          && GLEW_VERSION_4_3                                     ? true : false;
+    ogl::has_timer_query   = glewIsSupported("GL_ARB_timer_query")                ? true : false;
 
     // The light count is constrained by both uniform and varying limits.
 
@@ -83,6 +102,63 @@ static void init_opt()
 
     ogl::do_hdr_tonemap = (::conf->get_i("hdr_tonemap", 0) != 0);
     ogl::do_hdr_bloom   = (::conf->get_i("hdr_bloom",   0) != 0);
+
+    // Multi-draw indirect rendering
+
+    ogl::do_multi_draw  = (::conf->get_i("multi_draw",  1) != 0) && ogl::has_multi_draw;
+}
+
+// All texture and program bindings pass through the functions below, which
+// cache the current state and issue only the changes.  Outside of them,
+// texture unit zero is always active, as user code binding or configuring a
+// texture directly expects.  Deleted texture and program names are forgotten,
+// lest a recycled name appear to be bound already.
+
+#define MAX_TEXTURE_UNITS 16
+
+static GLuint current_object[MAX_TEXTURE_UNITS];
+static GLenum current_unit    = GL_TEXTURE0;
+static GLuint current_program = 0;
+
+static void reset_state()
+{
+    for (int u = 0; u < MAX_TEXTURE_UNITS; ++u)
+        current_object[u] = 0;
+
+    current_unit    = GL_TEXTURE0;
+    current_program = 0;
+}
+
+// Shaders supporting multi-draw find node transforms in a storage buffer,
+// indexed by base instance.  Draws not issued by a pool have base instance
+// zero, so a default buffer holding only the identity, with its identity
+// normal matrix, stands in for them.
+
+static GLuint identity_transform = 0;
+
+static void init_transforms()
+{
+    if (ogl::do_multi_draw)
+    {
+        const GLfloat I[32] = {
+            1.0f, 0.0f, 0.0f, 0.0f,
+            0.0f, 1.0f, 0.0f, 0.0f,
+            0.0f, 0.0f, 1.0f, 0.0f,
+            0.0f, 0.0f, 0.0f, 1.0f,
+
+            1.0f, 0.0f, 0.0f, 0.0f,
+            0.0f, 1.0f, 0.0f, 0.0f,
+            0.0f, 0.0f, 1.0f, 0.0f,
+            0.0f, 0.0f, 0.0f, 1.0f,
+        };
+
+        glGenBuffers(1, &identity_transform);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, identity_transform);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof (I), I, GL_STATIC_DRAW);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+        ogl::bind_transforms(0);
+    }
 }
 
 static void init_state(bool multisample)
@@ -99,6 +175,8 @@ void ogl::init(bool multisample)
 {
     init_opt();
     init_state(multisample);
+    reset_state();
+    init_transforms();
 
     ogl::context = true;
 }
@@ -110,11 +188,6 @@ void ogl::fini()
 
 //-----------------------------------------------------------------------------
 
-#define MAX_TEXTURE_UNITS 16
-
-static GLenum current_object[MAX_TEXTURE_UNITS];
-static GLenum current_unit = GL_TEXTURE0;
-
 void ogl::curr_texture(GLenum unit)
 {
     if (unit)
@@ -131,27 +204,27 @@ void ogl::bind_texture(GLenum target, GLenum unit, GLuint object)
 {
     // Bind a texture OBJECT to TARGET of texture UNIT with as little state
     // change as possible.  If UNIT is zero, then use whatever is current.
-/*
+
     int u = unit ? int(unit         - GL_TEXTURE0)
                  : int(current_unit - GL_TEXTURE0);
 
     if (current_object[u] != object)
     {
         current_object[u]  = object;
-        curr_texture(unit);
 
+        curr_texture(unit);
         glBindTexture(target, object);
+        curr_texture(GL_TEXTURE0);
     }
-*/
+}
 
-    if (unit == GL_TEXTURE0) // HACK: the above optimization breaks user code.
-        glBindTexture(target, object);
-    else
-    {
-        glActiveTexture(unit);
-        glBindTexture(target, object);
-        glActiveTexture(GL_TEXTURE0);
-    }
+void ogl::dele_texture(GLuint object)
+{
+    for (int u = 0; u < MAX_TEXTURE_UNITS; ++u)
+        if (current_object[u] == object)
+            current_object[u] = 0;
+
+    glDeleteTextures(1, &object);
 }
 
 void ogl::xfrm_texture(GLenum unit, const GLdouble *M)
@@ -164,6 +237,7 @@ void ogl::xfrm_texture(GLenum unit, const GLdouble *M)
         glLoadMatrixd(M);
     }
     glMatrixMode(GL_MODELVIEW);
+    curr_texture(GL_TEXTURE0);
 }
 
 void ogl::free_texture()
@@ -180,6 +254,32 @@ void ogl::free_texture()
 
         current_object[u] = 0;
     }
+    current_unit = GL_TEXTURE0;
+}
+
+void ogl::bind_program(GLuint object)
+{
+    if (current_program != object)
+    {
+        current_program  = object;
+        glUseProgram(object);
+    }
+}
+
+void ogl::dele_program(GLuint object)
+{
+    if (current_program == object)
+        bind_program(0);
+
+    glDeleteProgram(object);
+}
+
+// Bind the given node transform storage buffer, or the identity if zero.
+
+void ogl::bind_transforms(GLuint buffer)
+{
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, NODE_TRANSFORM_BINDING,
+                     buffer ? buffer : identity_transform);
 }
 
 //-----------------------------------------------------------------------------
@@ -10,20 +10,16 @@
 //  MERCHANTABILITY  or FITNESS  FOR A  PARTICULAR PURPOSE.   See  the GNU
 //  General Public License for more details.
 
+#include <algorithm>
+#include <cstddef>
+
 #include <etc-vector.hpp>
+#include <etc-task.hpp>
 #include <app-glob.hpp>
 #include <ogl-pool.hpp>
 
 //=============================================================================
 
-#define get_bit(b, i) (((b) >> ((i)    )) & 1)
-#define get_oct(b, i) (((b) >> ((i) * 3)) & 7)
-
-#define set_bit(b, i, n) (((b) & (~(1 << ((i)    )))) | ((n) << ((i)    )))
-#define set_oct(b, i, n) (((b) & (~(7 << ((i) * 3)))) | ((n) << ((i) * 3)))
-
-//-----------------------------------------------------------------------------
-
 ogl::elem::elem(const binding *b,
                 const GLuint  *o, GLenum t, GLsizei n, GLuint a, GLuint z) :
     bnd(b),
@@ -66,29 +62,388 @@ void ogl::elem::merge(const elem& that)
     max  = std::max(max, that.max);
 }
 
-void ogl::elem::draw(bool color) const
+void ogl::elem::draw(bool color, const binding *& last) const
 {
-    // Bind this batch's state and render all elements.
+    // Bind this batch's state, unless it is already bound by the last batch
+    // drawn, and render all elements.
 
-    if (bnd)
+    if (bnd && bnd != last)
         bnd->bind(color);
 
+    last = bnd;
+
     glDrawRangeElements(typ, min, max, num, GL_UNSIGNED_INT, off);
 }
 
+ogl::draw_item ogl::elem::item(GLuint slot) const
+{
+    // Give this batch as a multi-draw command of the node in the given slot.
+
+    draw_item d;
+
+    d.bnd = bnd;
+    d.typ = typ;
+
+    d.cmd.count          = GLuint(num);
+    d.cmd.instance_count = 1;
+    d.cmd.first_index    = GLuint(size_t(off) / sizeof (GLuint));
+    d.cmd.base_vertex    = 0;
+    d.cmd.base_instance  = slot;
+
+    return d;
+}
+
+//=============================================================================
+
+ogl::heap::heap() : total(0), inuse(0)
+{
+}
+
+GLuint ogl::heap::get(GLsizei n)
+{
+    if (n > 0)
+    {
+        block_m::iterator i;
+
+        // Find the first free block large enough.  Grow the heap if none is.
+
+        for (i = blocks.begin(); i != blocks.end(); ++i)
+            if (i->second >= n)
+                break;
+
+        if (i == blocks.end())
+        {
+            grow(n);
+            return get(n);
+        }
+
+        // Claim the head of the block and return the remainder to the list.
+
+        const GLuint  o = i->first;
+        const GLsizei m = i->second;
+
+        blocks.erase(i);
+
+        if (m > n)
+            blocks.insert(block_m::value_type(o + n, m - n));
+
+        inuse += n;
+        return o;
+    }
+    return 0;
+}
+
+void ogl::heap::put(GLuint o, GLsizei n)
+{
+    if (n > 0)
+    {
+        block_m::iterator i = blocks.insert(block_m::value_type(o, n)).first;
+        block_m::iterator j;
+
+        // Coalesce the released block with its free successor.
+
+        if ((j = i, ++j) != blocks.end() && i->first + i->second == j->first)
+        {
+            i->second += j->second;
+            blocks.erase(j);
+        }
+
+        // Coalesce the released block with its free predecessor.
+
+        if (i != blocks.begin() && (j = i, --j)->first + j->second == i->first)
+        {
+            j->second += i->second;
+            blocks.erase(i);
+        }
+
+        inuse -= n;
+    }
+}
+
+void ogl::heap::grow(GLsizei n)
+{
+    // Double the heap, or more if necessary.  Release the new space.
+
+    const GLsizei m = std::max(total * 2, total + n);
+
+    inuse += m - total;
+    put(GLuint(total), m - total);
+    total = m;
+}
+
+void ogl::heap::clear()
+{
+    blocks.clear();
+    total = 0;
+    inuse = 0;
+}
+
+bool ogl::heap::sparse() const
+{
+    // A large heap that is mostly free merits compaction.
+
+    return (total > 65536 && inuse < total / 4);
+}
+
+//=============================================================================
+
+ogl::tree::tree() : stale(0)
+{
+}
+
+// Order tree items by the center of their bound along one axis.
+
+namespace ogl
+{
+    struct itemcmp
+    {
+        int k;
+
+        itemcmp(int k) : k(k) { }
+
+        template <typename T> bool operator()(const T& a, const T& b) const {
+            return (a.bound.center()[k] < b.bound.center()[k]);
+        }
+    };
+}
+
+//-----------------------------------------------------------------------------
+
+void ogl::tree::build(const node_s& nodes)
+{
+    branches.clear();
+    moved   .clear();
+    items   .clear();
+
+    stale = 0;
+
+    // Gather the world-space bounds of all nodes subject to culling.
+
+    for (node_s::const_iterator i = nodes.begin(); i != nodes.end(); ++i)
+    {
+        (*i)->set_leaf(-1);
+
+        if (!(*i)->is_ubiq())
+        {
+            item t;
+
+            t.node  = (*i);
+            t.bound = (*i)->get_world_bound();
+
+            items.push_back(t);
+        }
+    }
+
+    // Build the hierarchy top-down.
+
+    if (!items.empty())
+    {
+        branches.reserve(items.size() * 2 - 1);
+        make(items.begin(), items.end(), -1);
+    }
+}
+
+int ogl::tree::make(item_v::iterator a, item_v::iterator z, int parent)
+{
+    const int b = int(branches.size());
+
+    branches.push_back(branch());
+
+    branches[b].parent = parent;
+    branches[b].l      = -1;
+    branches[b].r      = -1;
+    branches[b].leaf   =  0;
+
+    if (z - a == 1)
+    {
+        // A single item is a leaf.
+
+        branches[b].leaf  = a->node;
+        branches[b].bound = a->bound;
+
+        a->node->set_leaf(b);
+    }
+    else
+    {
+        // Split at the median along the longest axis of the item centers.
+
+        aabb c;
+
+        for (item_v::iterator i = a; i != z; ++i)
+            c.merge(i->bound.center());
+
+        const vec3 d = c.length();
+        const int  k = (d[0] > d[1]) ? ((d[0] > d[2]) ? 0 : 2)
+                                     : ((d[1] > d[2]) ? 1 : 2);
+
+        item_v::iterator m = a + (z - a) / 2;
+
+        std::nth_element(a, m, z, itemcmp(k));
+
+        const int l = make(a, m, b);
+        const int r = make(m, z, b);
+
+        branches[b].l = l;
+        branches[b].r = r;
+
+        branches[b].bound = branches[l].bound;
+        branches[b].bound.merge(branches[r].bound);
+    }
+    return b;
+}
+
+//-----------------------------------------------------------------------------
+
+void ogl::tree::move(node_p p)
+{
+    if (p->get_leaf() >= 0)
+        moved.push_back(p->get_leaf());
+}
+
+void ogl::tree::refit()
+{
+    if (!moved.empty())
+    {
+        if (moved.size() > items.size() / 4)
+        {
+            // Many leaves moved.  Refit all.  Children follow their parents.
+
+            for (int b = int(branches.size()) - 1; b >= 0; --b)
+                if (branches[b].leaf)
+                    branches[b].bound = branches[b].leaf->get_world_bound();
+                else
+                {
+                    branches[b].bound = branches[branches[b].l].bound;
+                    branches[b].bound.merge(branches[branches[b].r].bound);
+                }
+        }
+        else
+        {
+            // Few leaves moved.  Refit each and its ancestors.
+
+            for (std::vector<int>::iterator i = moved.begin(); i != moved.end(); ++i)
+            {
+                branches[*i].bound = branches[*i].leaf->get_world_bound();
+
+                for (int b = branches[*i].parent; b >= 0; b = branches[b].parent)
+                {
+                    branches[b].bound = branches[branches[b].l].bound;
+                    branches[b].bound.merge(branches[branches[b].r].bound);
+                }
+            }
+        }
+
+        // Note the degradation of the hierarchy.
+
+        stale += int(moved.size());
+        moved.clear();
+    }
+}
+
+//-----------------------------------------------------------------------------
+
+ogl::aabb ogl::tree::view(int id, int c, const vec4 *const *V, int n, aabb *B)
+{
+    // Assume all nodes invisible.  The traversal marks those that are not.
+
+    for (item_v::iterator i = items.begin(); i != items.end(); ++i)
+        i->node->set_test(id, c, false);
+
+    for (int j = 0; j < c; ++j)
+        B[j] = aabb();
+
+    // Test up to 32 frusta at once, one mask word per traversal.
+
+    if (!branches.empty())
+        for (int j = 0; j < c; j += 32)
+        {
+            const int k = std::min(c - j, 32);
+
+            cull(0, id + j, k, V + j, n, (k < 32) ? ((1U << k) - 1)
+                                                  : 0xFFFFFFFF, 0, B + j);
+        }
+
+    // Return the union of the visible bounds.
+
+    aabb b;
+
+    for (int j = 0; j < c; ++j)
+        b.merge(B[j]);
+
+    return b;
+}
+
+void ogl::tree::cull(int b, int id, int c, const vec4 *const *V, int n,
+                     unsigned int active, unsigned int inside, aabb *B)
+{
+    const branch& t = branches[b];
+
+    // Classify this bound against each frustum that it might straddle.
+
+    for (int j = 0; j < c; ++j)
+    {
+        const unsigned int bit = 1U << j;
+
+        if (active & bit)
+        {
+            bool in = true;
+            int  k;
+
+            for (k = 0; k < n; ++k)
+            {
+                if (t.bound.max(V[j][k]) < 0) break;
+                if (t.bound.min(V[j][k]) < 0) in = false;
+            }
+
+            // Cease testing frusta found to exclude or include this bound.
+
+            if      (k < n) active &= ~bit;
+            else if (in)  { active &= ~bit; inside |= bit; }
+        }
+    }
+
+    if (active | inside)
+    {
+        if (t.leaf)
+        {
+            // Mark the leaf visible in each frustum that includes it, or that
+            // straddles its world bound and passes the tighter local test.
+
+            for (int j = 0; j < c; ++j)
+            {
+                const unsigned int bit = 1U << j;
+
+                if ((inside & bit) || ((active & bit) &&
+                                       t.leaf->test(id + j, V[j], n)))
+                {
+                    t.leaf->set_test(id + j, true);
+                    B[j].merge(t.bound);
+                }
+            }
+        }
+        else
+        {
+            cull(t.l, id, c, V, n, active, inside, B);
+            cull(t.r, id, c, V, n, active, inside, B);
+        }
+    }
+}
+
 //=============================================================================
 
 int ogl::unit::serial = 0;
 
-ogl::unit::unit(std::string name, bool center) :
+ogl::unit::unit(std::string name, bool center, bool async) :
     id(serial++),
     vc(0),
     ec(0),
+    vo(0),
     my_node(0),
     rebuff(true),
     active(true),
     ubiquitous(false),
-    surf(glob->load_surface(name, center))
+    loaded(false),
+    surf(glob->load_surface(name, center, async))
 {
     set_mesh();
 }
@@ -97,10 +452,12 @@ ogl::unit::unit(const unit& that) :
     id(serial++),
     vc(0),
     ec(0),
+    vo(0),
     my_node(0),
     rebuff(true),
     active(true),
     ubiquitous(false),
+    loaded(false),
     surf(glob->dupe_surface(that.surf))
 {
     M = that.M;
@@ -155,6 +512,10 @@ const ogl::binding *ogl::unit::get_default_binding() const
 
 void ogl::unit::set_mesh()
 {
+    // A surface still loading has no meshes yet.
+
+    loaded = (surf == 0 || surf->is_ready());
+
     // Create a cache for each mesh.  Count vertices and elements.
 
     for (size_t i = 0; surf && i < surf->max_mesh(); ++i)
@@ -171,11 +532,44 @@ void ogl::unit::set_mesh()
     }
 }
 
+// Take up the meshes of a surface that has finished loading. The unit must not
+// hold buffer space at the time, as its vertex count changes.
+
+void ogl::unit::set_ready()
+{
+    if (!loaded) set_mesh();
+}
+
+// Block until the surface of a loading unit is ready and take up its meshes,
+// as needed by any user of its bound.
+
+void ogl::unit::wait()
+{
+    if (!loaded)
+    {
+        node_p n = my_node;
+
+        if (n) n->rem_unit(this);
+        glob->wait_surface(surf);
+        set_mesh();
+        if (n) n->add_unit(this);
+    }
+}
+
 void ogl::unit::set_node(node_p p)
 {
     my_node = p;
 }
 
+void ogl::unit::set_voff(GLuint o)
+{
+    // Note the new vertex buffer slice.  Mark it for a buffer update.
+
+    if (my_node) my_node->set_rebuff();
+    rebuff = true;
+    vo     = o;
+}
+
 void ogl::unit::set_mode(bool b)
 {
     if (my_node) my_node->set_resort();
@@ -225,7 +619,10 @@ void ogl::unit::merge_bound(aabb& b) const
 #endif
 //-----------------------------------------------------------------------------
 
-void ogl::unit::buff(bool b)
+// Caching may be performed by a worker thread, as it touches only the state of
+// this unit and its own cache meshes.
+
+void ogl::unit::cache(bool b)
 {
     if (b || rebuff)
     {
@@ -242,14 +639,67 @@ void ogl::unit::buff(bool b)
     rebuff = false;
 }
 
+void ogl::unit::buff(GLfloat *v, GLfloat *n, GLfloat *t, GLfloat *u)
+{
+    // Upload each changed mesh to this unit's slice of the bound buffer.
+
+    v += vo * 3;
+    n += vo * 3;
+    t += vo * 3;
+    u += vo * 3;
+
+    for (mesh_m::iterator i = my_mesh.begin(); i != my_mesh.end(); ++i)
+    {
+        const GLsizei vc = i->second->count_verts();
+
+        i->second->buffv(v, n, t, u);
+
+        v += vc * 3;
+        n += vc * 3;
+        t += vc * 3;
+        u += vc * 3;
+    }
+}
+
+void ogl::unit::buff(GLpack *p)
+{
+    // Upload each changed mesh to this unit's slice of the bound buffer.
+
+    p += vo;
+
+    for (mesh_m::iterator i = my_mesh.begin(); i != my_mesh.end(); ++i)
+    {
+        i->second->buffp(p);
+        p += i->second->count_verts();
+    }
+}
+
+void ogl::unit::sort()
+{
+    // Cache each mesh's elements, offset to its place in this unit's slice.
+
+    GLuint d = vo;
+
+    for (mesh_m::iterator i = my_mesh.begin(); i != my_mesh.end(); ++i)
+    {
+        i->second->cache_faces(i->first, d);
+        i->second->cache_lines(i->first, d);
+
+        d += i->first->count_verts();
+    }
+}
+
 //=============================================================================
 
 ogl::node::node() :
     vc(0), ec(0),
+    eo(0), en(0),
+    leaf(-1),
+    slot(0),
+    ubiquitous(false),
     rebuff(true),
-    my_pool(0),
-    test_cache(0xFFFFFFFF),
-    hint_cache(0x00000000)
+    resort(true),
+    my_pool(0)
 {
 }
 
@@ -276,6 +726,17 @@ void ogl::node::set_rebuff()
 void ogl::node::set_resort()
 {
     if (my_pool) my_pool->set_resort();
+    resort = true;
+}
+
+void ogl::node::set_eoff(GLuint o, GLsizei n)
+{
+    // Note the new element buffer slice.  Mark it for a resort.
+
+    eo = o;
+    en = n;
+
+    set_resort();
 }
 
 //-----------------------------------------------------------------------------
@@ -299,12 +760,14 @@ void ogl::node::add_unit(unit_p p)
         vc += p->vcount();
         ec += p->ecount();
 
-        if (my_pool) my_pool->add_vcount(+p->vcount());
-        if (my_pool) my_pool->add_ecount(+p->ecount());
+        // Allocate buffer space for the unit.  Grow this node's elements.
 
-        // Mark this node's pool for a resort.
+        if (my_pool) my_pool->alloc_unit(p);
+        if (my_pool) my_pool->alloc_node(this);
 
-        if (my_pool) my_pool->set_resort();
+        // Mark this node for a resort.
+
+        set_resort();
     }
 }
 
@@ -322,49 +785,65 @@ void ogl::node::rem_unit(unit_p p)
         vc -= p->vcount();
         ec -= p->ecount();
 
-        if (my_pool) my_pool->add_vcount(-p->vcount());
-        if (my_pool) my_pool->add_ecount(-p->ecount());
+        // Release the unit's buffer space.
+
+        if (my_pool) my_pool->free_unit(p);
 
-        // Mark this node's pool for a resort.
+        // Mark this node for a resort.
 
-        if (my_pool) my_pool->set_resort();
+        set_resort();
     }
 }
 
 //-----------------------------------------------------------------------------
 
+void ogl::node::cache(unit_v& units, bool b)
+{
+    // Gather all units in need of vertex pretransformation.
+
+    if (b || rebuff)
+        units.insert(units.end(), my_unit.begin(), my_unit.end());
+}
+
 void ogl::node::buff(GLfloat *v, GLfloat *n, GLfloat *t, GLfloat *u, bool b)
 {
     if (b || rebuff)
     {
-        // Have each unit pretransform its vertex data and compute its bound.
+        // Have each unit upload its pretransformed vertex data.
 
         my_aabb = aabb();
 
         for (unit_s::iterator i = my_unit.begin(); i != my_unit.end(); ++i)
         {
-            (*i)->buff(b);
+            (*i)->buff(v, n, t, u);
             my_aabb.merge((*i)->get_bound());
         }
 
-        // Upload each mesh's vertex data to the bound buffer object.
+        if (my_pool) my_pool->set_moved(this);
+    }
+    rebuff = false;
+}
 
-        for (mesh_m::iterator i = my_mesh.begin(); i != my_mesh.end(); ++i)
-        {
-            const GLsizei vc = i->second->count_verts();
+void ogl::node::buff(GLpack *p, bool b)
+{
+    if (b || rebuff)
+    {
+        // Have each unit upload its pretransformed, packed vertex data.
 
-            i->second->buffv(v, n, t, u);
+        my_aabb = aabb();
 
-            v += vc * 3;
-            n += vc * 3;
-            t += vc * 3;
-            u += vc * 3;
+        for (unit_s::iterator i = my_unit.begin(); i != my_unit.end(); ++i)
+        {
+            (*i)->buff(p);
+            my_aabb.merge((*i)->get_bound());
         }
+
+        if (my_pool) my_pool->set_moved(this);
     }
     rebuff = false;
 }
 
-void ogl::node::sort(GLuint *e, GLuint d)
+void ogl::node::sort()
 {
     // Create a list of all meshes of this node, sorted by material.
 
@@ -373,6 +852,7 @@ void ogl::node::sort(GLuint *e, GLuint d)
 
     for (unit_s::iterator i = my_unit.begin(); i != my_unit.end(); ++i)
     {
+        (*i)->sort();
         (*i)->merge_batch(my_mesh);
         ubiquitous |= (*i)->is_ubiq();
     }
@@ -381,18 +861,14 @@ void ogl::node::sort(GLuint *e, GLuint d)
 
     elem_v my_elem;
 
+    GLuint *e = (GLuint *) (eo * sizeof (GLuint));
+
     for (mesh_m::iterator i = my_mesh.begin(); i != my_mesh.end(); ++i)
     {
-        const GLsizei dc = i->first->count_verts();
         const GLsizei fc = i->first->count_faces() * 3;
         const GLsizei lc = i->first->count_lines() * 2;
 
-        // Cache each offset mesh.
-
-        i->second->cache_faces(i->first, d);
-        i->second->cache_lines(i->first, d);
-
-        // Upload elements to the bound buffer object.
+        // Upload elements to this node's slice of the bound buffer object.
 
         i->second->buffe(e);
 
@@ -407,7 +883,6 @@ void ogl::node::sort(GLuint *e, GLuint d)
                                        i->second->get_min(),
                                        i->second->get_max()));
         e += lc;
-        d += dc;
     }
 
     // Create a minimal vector of batches for each draw mode.
@@ -452,6 +927,7 @@ void ogl::node::sort(GLuint *e, GLuint d)
                 masked_color.back().merge(*i);
         }
     }
+    resort = false;
 }
 
 //-----------------------------------------------------------------------------
@@ -459,6 +935,8 @@ void ogl::node::sort(GLuint *e, GLuint d)
 void ogl::node::transform(const mat4& M)
 {
     this->M = M;
+
+    if (my_pool) my_pool->set_moved(this);
 }
 
 mat4 ogl::node::get_world_transform() const
@@ -466,40 +944,114 @@ mat4 ogl::node::get_world_transform() const
     return M;
 }
 
+ogl::aabb ogl::node::get_world_bound() const
+{
+    // An empty bound remains empty under any transform.
+
+    if (my_aabb.min()[0] > my_aabb.max()[0])
+        return aabb();
+    else
+        return aabb(my_aabb, M);
+}
+
 //-----------------------------------------------------------------------------
 
 ogl::aabb ogl::node::view(int id, const vec4 *V, int n)
 {
     if (!ubiquitous)
     {
-        // Get the cached culler hint.
+        // Test the bounding box.  If visible, return the world-space AABB.
 
-        int bit, hint = get_oct(hint_cache, id);
+        if (V == 0)
+            set_test(id, true);
 
-        // Test the bounding box and set the visibility bit.
+        else if (test(id, V, n))
+            return ogl::aabb(my_aabb, M);
+    }
+    return ogl::aabb();
+}
 
-        if (V == 0 || my_aabb.test(V, n, M, hint))
-            test_cache = set_bit(test_cache, id, (bit = 1));
-        else
-            test_cache = set_bit(test_cache, id, (bit = 0));
+bool ogl::node::test(int id, const vec4 *V, int n)
+{
+    // Get the cached culler hint.
 
-        // Set the cached culler hint.
+    if (int(hint_cache.size()) <= id)
+        hint_cache.resize(id + 1, 0);
 
-        hint_cache = set_oct(hint_cache, id, hint);
+    int hint = hint_cache[id];
 
-        // If this node is visible, return the world-space AABB.
+    // Test the bounding box and set the visibility bit.
 
-        if (bit && V)
-            return ogl::aabb(my_aabb, M);
+    const bool bit = my_aabb.test(V, n, M, hint);
+
+    set_test(id, bit);
+
+    // Set the cached culler hint.
+
+    hint_cache[id] = (unsigned char) hint;
+
+    return bit;
+}
+
+bool ogl::node::get_test(int id) const
+{
+    // Frusta never tested are assumed visible.
+
+    const size_t w = size_t(id) >> 5;
+
+    if (w < test_cache.size())
+        return (test_cache[w] >> (id & 31)) & 1;
+    else
+        return true;
+}
+
+void ogl::node::set_test(int id, bool b)
+{
+    const size_t w = size_t(id) >> 5;
+
+    if (w >= test_cache.size())
+        test_cache.resize(w + 1, 0xFFFFFFFF);
+
+    if (b)
+        test_cache[w] |=  (1U << (id & 31));
+    else
+        test_cache[w] &= ~(1U << (id & 31));
+}
+
+void ogl::node::set_test(int id, int c, bool b)
+{
+    // Set a range of visibility bits, a whole word at a time where possible.
+
+    if (c > 0)
+    {
+        const size_t w = size_t(id + c - 1) >> 5;
+
+        if (w >= test_cache.size())
+            test_cache.resize(w + 1, 0xFFFFFFFF);
+
+        while (c > 0)
+        {
+            const int o = id & 31;
+            const int k = std::min(c, 32 - o);
+
+            const unsigned int m = (k < 32) ? (((1U << k) - 1) << o)
+                                            : 0xFFFFFFFF;
+            if (b)
+                test_cache[id >> 5] |=  m;
+            else
+                test_cache[id >> 5] &= ~m;
+
+            id += k;
+            c  -= k;
+        }
     }
-    return ogl::aabb();
 }
 
-void ogl::node::draw(int id, bool color, bool alpha)
+void ogl::node::draw(int id, bool color, bool alpha, draw_item_v *queue)
 {
     // Proceed if this node passed visibility test ID.
 
-    if (ubiquitous || get_bit(test_cache, id))
+    if (ubiquitous || get_test(id))
     {
         // Select the batch vector.  Confirm that it is non-empty.
 
@@ -517,16 +1069,37 @@ void ogl::node::draw(int id, bool color, bool alpha)
         {
             // if (alpha) { glEnable(GL_ALPHA_TEST); };
 
-            // Render the selected batches.
+            // Given a queue, defer the batches that permit multi-draw to it.
+
+            bool direct = true;
 
-            glPushMatrix();
+            if (queue)
             {
-                glMultMatrixd(transpose(M));
+                direct = false;
 
                 for (elem_i i = b; i != e; ++i)
-                    i->draw(color);
+                    if (i->indirect(color))
+                        queue->push_back(i->item(slot));
+                    else
+                        direct = true;
+            }
+
+            // Render the remaining batches.
+
+            if (direct)
+            {
+                glPushMatrix();
+                {
+                    const binding *last = 0;
+
+                    glMultMatrixd(transpose(M));
+
+                    for (elem_i i = b; i != e; ++i)
+                        if (!queue || !i->indirect(color))
+                            i->draw(color, last);
+                }
+                glPopMatrix();
             }
-            glPopMatrix();
 
             // if (alpha) { glDisable(GL_ALPHA_TEST); };
         }
@@ -535,7 +1108,60 @@ void ogl::node::draw(int id, bool color, bool alpha)
 
 //=============================================================================
 
-ogl::pool::pool() : vc(0), ec(0), resort(true), rebuff(true), vbo(0), ebo(0)
+// A cache task pretransforms the vertices of a share of a pool's units.
+
+namespace ogl
+{
+    class cache_task : public etc::task
+    {
+    public:
+
+        cache_task(bool b) : force(b), verts(0) { }
+
+        void add(unit_p p)
+        {
+            units.push_back(p);
+            verts += p->vcount();
+        }
+
+        void run()
+        {
+            for (unit_v::iterator i = units.begin(); i != units.end(); ++i)
+                (*i)->cache(force);
+        }
+
+        GLsizei vcount() const { return verts; }
+
+    private:
+
+        bool    force;
+        GLsizei verts;
+        unit_v  units;
+    };
+
+    typedef std::vector<cache_task> cache_task_v;
+}
+
+// Pretransformation is distributed only when there is enough work to repay
+// the cost of dispatch.
+
+#define MIN_PARALLEL_VCOUNT 16384
+
+//=============================================================================
+
+ogl::pool::pool(bool packed) :
+    vbo_size(0),
+    ebo_size(0),
+    resort(true),
+    rebuff(true),
+    packed_opt(packed),
+    packed(false),
+    rebuild(true),
+    restage(true),
+    vbo(0),
+    ebo(0),
+    xbo(0),
+    dbo(0)
 {
     init();
 }
@@ -560,14 +1186,62 @@ void ogl::pool::set_rebuff()
     rebuff = true;
 }
 
-void ogl::pool::add_vcount(GLsizei vc)
+void ogl::pool::set_moved(node_p p)
+{
+    my_tree.move(p);
+    restage = true;
+}
+
+// Resort every node, as when the opacity of a material has changed.
+
+void ogl::pool::set_resort_all()
+{
+    for (node_s::iterator i = my_node.begin(); i != my_node.end(); ++i)
+        (*i)->set_resort();
+
+    resort = true;
+}
+
+//-----------------------------------------------------------------------------
+
+// Any allocation may grow a heap beyond its buffer object, and any release may
+// leave a heap sparse, so each marks this pool for a resort.
+
+void ogl::pool::alloc_unit(unit_p p)
+{
+    if (p->is_loading()) loading.insert(p);
+
+    p->set_voff(vert_heap.get(p->vcount()));
+    set_resort();
+}
+
+void ogl::pool::free_unit(unit_p p)
 {
-    this->vc += vc;
+    loading.erase(p);
+
+    vert_heap.put(p->get_voff(), p->vcount());
+    set_resort();
 }
 
-void ogl::pool::add_ecount(GLsizei ec)
+void ogl::pool::alloc_node(node_p p)
 {
-    this->ec += ec;
+    // If the node's elements have outgrown its slice, move to a larger one.
+
+    if (p->ecount() > p->get_ecap())
+    {
+        const GLsizei n = p->ecount() + p->ecount() / 2;
+
+        elem_heap.put(p->get_eoff(), p->get_ecap());
+        p->set_eoff(elem_heap.get(n), n);
+    }
+    set_resort();
+}
+
+void ogl::pool::free_node(node_p p)
+{
+    elem_heap.put(p->get_eoff(), p->get_ecap());
+    p->set_eoff(0, 0);
+    set_resort();
 }
 
 //-----------------------------------------------------------------------------
@@ -579,93 +1253,208 @@ void ogl::pool::add_node(node_p p)
     my_node.insert(p);
     p->set_pool(this);
 
-    // Include the node's vertex and element counts.
+    // Allocate buffer space for the node and all of its units.
 
-    vc += p->vcount();
-    ec += p->ecount();
+    const unit_s& units = p->get_units();
 
-    // Mark this pool and its pool for a resort.
+    for (unit_s::const_iterator i = units.begin(); i != units.end(); ++i)
+        alloc_unit(*i);
 
-    set_resort();
+    alloc_node(p);
+
+    rebuild = true;
+    restage = true;
 }
 
 void ogl::pool::rem_node(node_p p)
 {
-    // Erase the given node from the node set.
+    // Release the buffer space of the node and all of its units.
 
-    my_node.erase(p);
-    p->set_pool(0);
+    const unit_s& units = p->get_units();
 
-    // Omit the node's vertex and element counts.
+    for (unit_s::const_iterator i = units.begin(); i != units.end(); ++i)
+        free_unit(*i);
 
-    vc -= p->vcount();
-    ec -= p->ecount();
+    free_node(p);
 
-    // Mark this pool and its pool for a resort.
+    // Erase the given node from the node set.
 
-    set_resort();
+    my_node.erase(p);
+    p->set_pool(0);
+    p->set_leaf(-1);
+    p->set_slot(0);
+
+    rebuild = true;
+    restage = true;
 }
 
 //-----------------------------------------------------------------------------
 
+GLsizei ogl::pool::vsize() const
+{
+    return packed ? sizeof (GLpack) : sizeof (GLfloat) * 12;
+}
+
 void ogl::pool::buff(bool force)
 {
     // Compute buffer object offsets for each vertex attribute.
 
     GLfloat *v = (GLfloat *) (0);
-    GLfloat *n = (GLfloat *) (vc * sizeof (GLfloat) * 3);
-    GLfloat *t = (GLfloat *) (vc * sizeof (GLfloat) * 6);
-    GLfloat *u = (GLfloat *) (vc * sizeof (GLfloat) * 9);
+    GLfloat *n = (GLfloat *) (vbo_size * sizeof (GLfloat) * 3);
+    GLfloat *t = (GLfloat *) (vbo_size * sizeof (GLfloat) * 6);
+    GLfloat *u = (GLfloat *) (vbo_size * sizeof (GLfloat) * 9);
+    GLpack  *p = (GLpack  *) (0);
 
-    // Rebuff all nodes.
+    // Gather the units of all nodes needing an update.
+
+    unit_v  units;
+    GLsizei vc = 0;
 
     for (node_s::iterator i = my_node.begin(); i != my_node.end(); ++i)
+        (*i)->cache(units, force);
+
+    for (unit_v::iterator i = units.begin(); i != units.end(); ++i)
+        vc += (*i)->vcount();
+
+    // Pretransform their vertices, in parallel if worthwhile.
+
+    if (::workers && ::workers->size() && vc > MIN_PARALLEL_VCOUNT)
     {
-        const GLsizei vc = (*i)->vcount();
+        cache_task_v tasks(::workers->size() + 1, cache_task(force));
+        etc::batch   batch;
 
-        (*i)->buff(v, n, t, u, force);
+        // Deal each unit to the task with the least work so far.
 
-        v += vc * 3;
-        n += vc * 3;
-        t += vc * 3;
-        u += vc * 3;
+        for (unit_v::iterator i = units.begin(); i != units.end(); ++i)
+        {
+            cache_task_v::iterator k = tasks.begin();
+
+            for (cache_task_v::iterator j = tasks.begin(); j != tasks.end(); ++j)
+                if (j->vcount() < k->vcount())
+                    k = j;
+
+            k->add(*i);
+        }
+
+        for (cache_task_v::iterator j = tasks.begin(); j != tasks.end(); ++j)
+            ::workers->push(&(*j), &batch);
+
+        ::workers->wait(&batch);
     }
+    else
+        for (unit_v::iterator i = units.begin(); i != units.end(); ++i)
+            (*i)->cache(force);
+
+    // Rebuff all nodes.  Each unit knows its own slice.
+
+    for (node_s::iterator i = my_node.begin(); i != my_node.end(); ++i)
+        if (packed)
+            (*i)->buff(p, force);
+        else
+            (*i)->buff(v, n, t, u, force);
+
     rebuff = false;
 }
 
 void ogl::pool::sort()
 {
-    GLsizei vsz = vc * sizeof (GLfloat) * 12;
-    GLsizei esz = ec * sizeof (GLuint);
+    bool force = false;
 
-    // Initialize vertex and element buffer sizes.
+    // Compact the heaps once they have become mostly empty.
 
-    glBufferData(GL_ARRAY_BUFFER,         vsz, 0, GL_STATIC_DRAW);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, esz, 0, GL_STATIC_DRAW);
+    if (vert_heap.sparse() || elem_heap.sparse())
+        pack();
 
-    // Resort all nodes.
+    // Reallocate the buffer objects if the heaps have outgrown them.
 
-    GLuint *e = 0;
-    GLuint  d = 0;
+    if (vbo_size != vert_heap.size())
+    {
+        vbo_size  = vert_heap.size();
+        glBufferData(GL_ARRAY_BUFFER,
+                     vbo_size * vsize(),               0, GL_STATIC_DRAW);
+        force = true;
+    }
 
-    for (node_s::iterator i = my_node.begin(); i != my_node.end(); ++i)
+    if (ebo_size != elem_heap.size())
     {
-        (*i)->sort(e, d);
+        ebo_size  = elem_heap.size();
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER,
+                     ebo_size * sizeof (GLuint),       0, GL_STATIC_DRAW);
 
-        e += (*i)->ecount();
-        d += (*i)->vcount();
+        for (node_s::iterator i = my_node.begin(); i != my_node.end(); ++i)
+            (*i)->set_resort();
     }
+
+    // Resort only those nodes whose contents have changed.  A change in the
+    // ubiquity of a node changes the membership of the hierarchy.
+
+    for (node_s::iterator i = my_node.begin(); i != my_node.end(); ++i)
+        if ((*i)->is_resort())
+        {
+            const bool u = (*i)->is_ubiq();
+
+            (*i)->sort();
+
+            if (u != (*i)->is_ubiq())
+                rebuild = true;
+        }
+
     resort = false;
 
-    // Force-rebuff all nodes.
+    // A reallocated vertex buffer moves all attribute arrays.  Rebuff all.
+
+    if (force) buff(true);
+}
+
+void ogl::pool::pack()
+{
+    vert_heap.clear();
+    elem_heap.clear();
+
+    // Reassign all slices contiguously, without headroom.
+
+    for (node_s::iterator i = my_node.begin(); i != my_node.end(); ++i)
+    {
+        const unit_s& units = (*i)->get_units();
+
+        for (unit_s::const_iterator j = units.begin(); j != units.end(); ++j)
+            (*j)->set_voff(vert_heap.get((*j)->vcount()));
 
-    buff(true);
+        (*i)->set_eoff(elem_heap.get((*i)->ecount()), (*i)->ecount());
+    }
+
+    // Zero the buffer sizes to force reallocation and a complete upload.
+
+    vbo_size = 0;
+    ebo_size = 0;
 }
 
 //-----------------------------------------------------------------------------
 
 void ogl::pool::prep()
 {
+    // Reinsert any units whose surfaces have finished loading.
+
+    if (!loading.empty())
+    {
+        unit_v ready;
+
+        for (unit_i i = loading.begin(); i != loading.end(); ++i)
+            if ((*i)->is_ready())
+                ready.push_back(*i);
+
+        for (unit_v::iterator i = ready.begin(); i != ready.end(); ++i)
+        {
+            node_p n = (*i)->get_node();
+
+            n->rem_unit(*i);
+            (*i)->set_ready();
+            n->add_unit(*i);
+        }
+
+        if (!ready.empty()) rebuild = true;
+    }
+
     // Bind the VBO and EBO.
 
     if (resort || rebuff)
@@ -687,14 +1476,32 @@ void ogl::pool::prep()
 
 ogl::aabb ogl::pool::view(int id, const vec4 *V, int n)
 {
-    ogl::aabb b;
+    return view(id, 1, &V, n);
+}
 
-    // Test all nodes for visibility. Find the union of their bounds.
+ogl::aabb ogl::pool::view(int id, int c, const vec4 *const *V, int n, aabb *B)
+{
+    if (c < 1) return aabb();
 
-    for (node_s::iterator i = my_node.begin(); i != my_node.end(); ++i)
-        b.merge((*i)->view(id, V, n));
+    // Bring the hierarchy up to date with the addition and motion of nodes.
 
-    return b;
+    if (rebuild || my_tree.is_stale())
+    {
+        my_tree.build(my_node);
+        rebuild = false;
+    }
+    else my_tree.refit();
+
+    // Test all nodes for visibility in frusta ID through ID + C - 1.  Find the
+    // union of their bounds, and optionally the bound of each frustum.
+
+    if (B)
+        return my_tree.view(id, c, V, n, B);
+    else
+    {
+        std::vector<aabb> b(c);
+        return my_tree.view(id, c, V, n, &b.front());
+    }
 }
 
 //-----------------------------------------------------------------------------
@@ -713,27 +1520,72 @@ void ogl::pool::draw_init()
     glEnableClientState(GL_NORMAL_ARRAY);
     glEnableClientState(GL_VERTEX_ARRAY);
 
-    GLfloat *v = (GLfloat *) (0);
-    GLfloat *n = (GLfloat *) (vc * sizeof (GLfloat) * 3);
-    GLfloat *t = (GLfloat *) (vc * sizeof (GLfloat) * 6);
-    GLfloat *u = (GLfloat *) (vc * sizeof (GLfloat) * 9);
+    if (packed)
+    {
+        const GLsizei s = sizeof (GLpack);
+
+        GLvoid *v = (GLvoid *) offsetof(GLpack, v);
+        GLvoid *n = (GLvoid *) offsetof(GLpack, n);
+        GLvoid *t = (GLvoid *) offsetof(GLpack, t);
+        GLvoid *u = (GLvoid *) offsetof(GLpack, u);
+
+        glTexCoordPointer    (   4, GL_HALF_FLOAT,            s, u);
+        glVertexAttribPointer(6, 4, GL_INT_2_10_10_10_REV, 1, s, t);
+        glNormalPointer      (      GL_INT_2_10_10_10_REV,    s, n);
+        glVertexPointer      (   3, GL_FLOAT,                 s, v);
+    }
+    else
+    {
+        GLfloat *v = (GLfloat *) (0);
+        GLfloat *n = (GLfloat *) (vbo_size * sizeof (GLfloat) * 3);
+        GLfloat *t = (GLfloat *) (vbo_size * sizeof (GLfloat) * 6);
+        GLfloat *u = (GLfloat *) (vbo_size * sizeof (GLfloat) * 9);
+
+        glTexCoordPointer    (   3, GL_FLOAT,    sizeof (GLvec3), u);
+        glVertexAttribPointer(6, 3, GL_FLOAT, 0, sizeof (GLvec3), t);
+        glNormalPointer      (      GL_FLOAT,    sizeof (GLvec3), n);
+        glVertexPointer      (   3, GL_FLOAT,    sizeof (GLvec3), v);
+    }
+
+    // Bind the node transforms for multi-draw.
 
-    glTexCoordPointer    (   3, GL_FLOAT,    sizeof (GLvec3), u);
-    glVertexAttribPointer(6, 3, GL_FLOAT, 0, sizeof (GLvec3), t);
-    glNormalPointer      (      GL_FLOAT,    sizeof (GLvec3), n);
-    glVertexPointer      (   3, GL_FLOAT,    sizeof (GLvec3), v);
+    if (ogl::do_multi_draw)
+    {
+        if (restage) stage();
+
+        ogl::bind_transforms(xbo);
+    }
 }
 
 void ogl::pool::draw(int id, bool color, bool alpha)
 {
-    // Draw all nodes.
+    if (ogl::do_multi_draw)
+    {
+        // Draw all nodes, queueing those batches that permit multi-draw.
 
-    for (node_s::iterator i = my_node.begin(); i != my_node.end(); ++i)
-        (*i)->draw(id, color, alpha);
+        items.clear();
+
+        for (node_s::iterator i = my_node.begin(); i != my_node.end(); ++i)
+            (*i)->draw(id, color, alpha, &items);
+
+        draw_items(color);
+    }
+    else
+    {
+        // Draw all nodes.
+
+        for (node_s::iterator i = my_node.begin(); i != my_node.end(); ++i)
+            (*i)->draw(id, color, alpha);
+    }
 }
 
 void ogl::pool::draw_fini()
 {
+    // Restore the identity node transform.
+
+    if (ogl::do_multi_draw)
+        ogl::bind_transforms(0);
+
     // Disable the vertex arrays.
 
     glDisableClientState(GL_VERTEX_ARRAY);
@@ -749,6 +1601,84 @@ void ogl::pool::draw_fini()
 
 //-----------------------------------------------------------------------------
 
+// Upload all node transforms, in column-major order, following the identity
+// in slot zero.  Each slot pairs the transform with its inverse transpose, by
+// which normals are transformed.  Each node notes its slot for use as its base
+// instance.
+
+void ogl::pool::stage()
+{
+    transforms.assign(32 * (my_node.size() + 1), 0.0f);
+
+    transforms[ 0] = transforms[16] = 1.0f;
+    transforms[ 5] = transforms[21] = 1.0f;
+    transforms[10] = transforms[26] = 1.0f;
+    transforms[15] = transforms[31] = 1.0f;
+
+    GLuint k = 1;
+
+    for (node_s::iterator i = my_node.begin(); i != my_node.end(); ++i, ++k)
+    {
+        const mat4 M = (*i)->get_world_transform();
+        const mat4 I = inverse(M);
+
+        GLfloat *T = &transforms[32 * k];
+        GLfloat *N = &transforms[32 * k + 16];
+
+        for     (int c = 0; c < 4; ++c)
+            for (int r = 0; r < 4; ++r)
+            {
+                T[4 * c + r] = GLfloat(M[r][c]);
+                N[4 * c + r] = GLfloat(I[c][r]);
+            }
+
+        (*i)->set_slot(k);
+    }
+
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, xbo);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, transforms.size() * sizeof (GLfloat),
+                                          &transforms.front(), GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    restage = false;
+}
+
+// Sort the queued commands by binding and primitive type, upload them, and
+// issue one multi-draw for each run of commands sharing both.
+
+void ogl::pool::draw_items(bool color)
+{
+    if (!items.empty())
+    {
+        std::sort(items.begin(), items.end());
+
+        commands.resize(items.size());
+
+        for (size_t k = 0; k < items.size(); ++k)
+            commands[k] = items[k].cmd;
+
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, dbo);
+        glBufferData(GL_DRAW_INDIRECT_BUFFER, commands.size() * sizeof (draw_command),
+                                             &commands.front(), GL_STREAM_DRAW);
+
+        for (size_t i = 0, j = 0; i < items.size(); i = j)
+        {
+            for (j = i + 1; j < items.size() && !(items[i] < items[j]); ++j)
+                ;
+
+            items[i].bnd->bind(color);
+
+            glMultiDrawElementsIndirect(items[i].typ, GL_UNSIGNED_INT,
+                                        (const GLvoid *) (i * sizeof (draw_command)),
+                                        GLsizei(j - i), 0);
+        }
+
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    }
+}
+
+//-----------------------------------------------------------------------------
+
 void ogl::pool::init()
 {
     if (ogl::context)
@@ -756,8 +1686,24 @@ void ogl::pool::init()
         glGenBuffers(1, &vbo);
         glGenBuffers(1, &ebo);
 
-        resort = true;
-        rebuff = true;
+        if (ogl::do_multi_draw)
+        {
+            glGenBuffers(1, &xbo);
+            glGenBuffers(1, &dbo);
+        }
+
+        // Packing depends upon the capabilities of the new context.
+
+        packed = packed_opt && ogl::has_packed_verts;
+
+        // New buffer objects have no storage.  Force their reallocation.
+
+        vbo_size = 0;
+        ebo_size = 0;
+
+        resort  = true;
+        rebuff  = true;
+        restage = true;
     }
 }
 
@@ -765,9 +1711,13 @@ void ogl::pool::fini()
 {
     if (ogl::context)
     {
+        if (dbo) glDeleteBuffers(1, &dbo);
+        if (xbo) glDeleteBuffers(1, &xbo);
         if (ebo) glDeleteBuffers(1, &ebo);
         if (vbo) glDeleteBuffers(1, &vbo);
 
+        dbo = 0;
+        xbo = 0;
         ebo = 0;
         vbo = 0;
     }
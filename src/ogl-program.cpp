@@ -24,8 +24,42 @@
 
 const ogl::program *ogl::program::current = NULL;
 
+// The interned name table is held in function-local statics so that handles
+// may be constructed during static initialization.
+
+static std::vector<std::string>& handle_names()
+{
+    static std::vector<std::string> names;
+    return names;
+}
+
+static std::map<std::string, int>& handle_index()
+{
+    static std::map<std::string, int> index;
+    return index;
+}
+
+ogl::program::handle::handle(const std::string& name)
+{
+    std::map<std::string, int>::iterator i = handle_index().find(name);
+
+    if (i == handle_index().end())
+    {
+        index = int(handle_names().size());
+        handle_names().push_back(name);
+        handle_index()[name] = index;
+    }
+    else index = i->second;
+}
+
+const std::vector<std::string>& ogl::program::handle::names()
+{
+    return handle_names();
+}
+
 ogl::program::program(std::string name) :
-    name(name), vert(0), frag(0), prog(0), bindable(false), discard(false)
+    name(name), vert(0), frag(0), prog(0),
+    bindable(false), discard(false), indirect(false)
 {
     init();
 }
@@ -44,19 +78,29 @@ void ogl::program::prep() const
         uniform_map::const_iterator u;
         process_map::const_iterator p;
 
-        bind();
+        bool bound = false;
 
-        // Set all uniform values.
+        // Set all uniform values changed since the last prep, binding the
+        // program only if there is something to set.
 
         for (u = uniforms.begin(); u != uniforms.end(); ++u)
-            u->first->apply(u->second);
+            if (u->second.version != u->first->get_version())
+            {
+                if (!bound)
+                {
+                    bind();
+                    bound = true;
+                }
+                u->first->apply(u->second.location);
+                u->second.version = u->first->get_version();
+            }
 
         // Bind all process samplers.
 
         for (p = processes.begin(); p != processes.end(); ++p)
             p->first->bind(p->second);
 
-        free();
+        if (bound) free();
     }
 }
 
@@ -64,7 +108,7 @@ void ogl::program::bind() const
 {
     if (bindable)
     {
-        glUseProgram(prog);
+        ogl::bind_program(prog);
         current = this;
     }
 }
@@ -169,11 +213,26 @@ void ogl::program::init_uniforms(app::node p)
         if (!uniform.empty())
         {
             if (ogl::uniform *u = ::glob->load_uniform(uniform, size))
-                uniforms[u] = glGetUniformLocation(prog, name.c_str());
+                uniforms[u] = uniform_state(location(handle(name)));
         }
     }
 }
 
+// Prefix a vertex shader with the declarations needed to find node transforms
+// under multi-draw.  These replace any version directive the shader gives.
+
+static std::string indirect_text(const std::string& text)
+{
+    std::string body(text);
+
+    if (body.compare(0, 8, "#version") == 0)
+        body.erase(0, body.find('\n'));
+
+    return "#version 430 compatibility\n"
+           "#extension GL_ARB_shader_draw_parameters : require\n"
+           "#define INDIRECT\n" + body;
+}
+
 //-----------------------------------------------------------------------------
 
 bool ogl::program::program_log(GLuint handle, const std::string& name)
@@ -263,9 +322,14 @@ void ogl::program::init()
 
             discard = root.get_i("discard") ? true : false;
 
+            // A program may opt in to multi-draw, where supported.
+
+            indirect = root.get_i("indirect") && ogl::do_multi_draw;
+
             // Load the shader files.
 
-            const std::string vert_text = load(vert_name);
+            const std::string vert_text = indirect ? indirect_text(load(vert_name))
+                                                   :               load(vert_name);
             const std::string frag_text = load(frag_name);
 
             // Compile the shaders.
@@ -289,8 +353,11 @@ void ogl::program::init()
 
             // Configure the program.
 
+            // Resolve the locations of all uniforms named thus far.
+
             if (bindable)
             {
+                locate();
                 bind();
                 {
                     init_textures (root);
@@ -320,8 +387,9 @@ void ogl::program::fini()
         uniforms.clear();
         processes.clear();
         textures.clear();
+        locations.clear();
 
-        if (prog) glDeleteProgram(prog);
+        if (prog) ogl::dele_program(prog);
         if (vert) glDeleteShader(vert);
         if (frag) glDeleteShader(frag);
 
@@ -347,60 +415,119 @@ GLenum ogl::program::unit(std::string name) const
 
 //-----------------------------------------------------------------------------
 
+// Set a uniform by name.  This interns the name, bypassing the driver query.
+
 void ogl::program::uniform(std::string name, int d) const
+{
+    uniform(handle(name), d);
+}
+
+void ogl::program::uniform(std::string name, double a) const
+{
+    uniform(handle(name), a);
+}
+
+void ogl::program::uniform(std::string name, const vec2& v) const
+{
+    uniform(handle(name), v);
+}
+
+void ogl::program::uniform(std::string name, const vec3& v) const
+{
+    uniform(handle(name), v);
+}
+
+void ogl::program::uniform(std::string name, const vec4& v) const
+{
+    uniform(handle(name), v);
+}
+
+void ogl::program::uniform(std::string name, const mat3& M, bool t) const
+{
+    uniform(handle(name), M, t);
+}
+
+void ogl::program::uniform(std::string name, const mat4& M, bool t) const
+{
+    uniform(handle(name), M, t);
+}
+
+//-----------------------------------------------------------------------------
+
+// Resolve the locations of any names interned since the program was linked.
+
+void ogl::program::locate() const
+{
+    const std::vector<std::string>& names = handle::names();
+
+    for (size_t i = locations.size(); i < names.size(); ++i)
+        locations.push_back(glGetUniformLocation(prog, names[i].c_str()));
+}
+
+GLint ogl::program::location(handle h) const
+{
+    if (size_t(h.get()) >= locations.size())
+        locate();
+
+    return locations[h.get()];
+}
+
+//-----------------------------------------------------------------------------
+
+void ogl::program::uniform(handle h, int d) const
 {
     if (bindable)
     {
         int loc;
 
-        if ((loc = glGetUniformLocation(prog, name.c_str())) >= 0)
+        if ((loc = location(h)) >= 0)
             glUniform1i(loc, d);
     }
 }
 
-void ogl::program::uniform(std::string name, double a) const
+void ogl::program::uniform(handle h, double a) const
 {
     if (bindable)
     {
         int loc;
 
-        if ((loc = glGetUniformLocation(prog, name.c_str())) >= 0)
+        if ((loc = location(h)) >= 0)
             glUniform1f(loc, GLfloat(a));
     }
 }
 
-void ogl::program::uniform(std::string name, const vec2& v) const
+void ogl::program::uniform(handle h, const vec2& v) const
 {
     if (bindable)
     {
         int loc;
 
-        if ((loc = glGetUniformLocation(prog, name.c_str())) >= 0)
+        if ((loc = location(h)) >= 0)
             glUniform2f(loc, GLfloat(v[0]),
                              GLfloat(v[1]));
     }
 }
 
-void ogl::program::uniform(std::string name, const vec3& v) const
+void ogl::program::uniform(handle h, const vec3& v) const
 {
     if (bindable)
     {
         int loc;
 
-        if ((loc = glGetUniformLocation(prog, name.c_str())) >= 0)
+        if ((loc = location(h)) >= 0)
             glUniform3f(loc, GLfloat(v[0]),
                              GLfloat(v[1]),
                              GLfloat(v[2]));
     }
 }
 
-void ogl::program::uniform(std::string name, const vec4& v) const
+void ogl::program::uniform(handle h, const vec4& v) const
 {
     if (bindable)
     {
         int loc;
 
-        if ((loc = glGetUniformLocation(prog, name.c_str())) >= 0)
+        if ((loc = location(h)) >= 0)
             glUniform4f(loc, GLfloat(v[0]),
                              GLfloat(v[1]),
                              GLfloat(v[2]),
@@ -408,13 +535,13 @@ void ogl::program::uniform(std::string name, const vec4& v) const
     }
 }
 
-void ogl::program::uniform(std::string name, const mat3& M, bool t) const
+void ogl::program::uniform(handle h, const mat3& M, bool t) const
 {
     if (bindable)
     {
         int loc;
 
-        if ((loc = glGetUniformLocation(prog, name.c_str())) >= 0)
+        if ((loc = location(h)) >= 0)
         {
             GLfloat T[9];
 
@@ -433,13 +560,13 @@ void ogl::program::uniform(std::string name, const mat3& M, bool t) const
     }
 }
 
-void ogl::program::uniform(std::string name, const mat4& M, bool t) const
+void ogl::program::uniform(handle h, const mat4& M, bool t) const
 {
     if (bindable)
     {
         int loc;
 
-        if ((loc = glGetUniformLocation(prog, name.c_str())) >= 0)
+        if ((loc = location(h)) >= 0)
         {
             GLfloat T[16];
 
@@ -57,7 +57,7 @@ void ogl::shadow::bind(GLenum unit) const
     // A sun light clamps to light while a spot light clamps to dark. We have
     // to make a choice, so we assume a spot light has a clamping cookie.
 
-    glActiveTexture(unit);
+    ogl::curr_texture(unit);
     {
         GLfloat C[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
 
@@ -65,7 +65,7 @@ void ogl::shadow::bind(GLenum unit) const
         glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
         glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, C);
     }
-    glActiveTexture(GL_TEXTURE0);
+    ogl::curr_texture(GL_TEXTURE0);
 }
 
 //-----------------------------------------------------------------------------
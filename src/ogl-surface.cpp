@@ -10,8 +10,272 @@
 //  MERCHANTABILITY  or FITNESS  FOR A  PARTICULAR PURPOSE.   See  the GNU
 //  General Public License for more details.
 
+#include <cstring>
+
 #include <ogl-surface.hpp>
+#include <app-data.hpp>
+#include <app-conf.hpp>
+
+//-----------------------------------------------------------------------------
+
+// A binary surface cache begins with this header, which identifies the format
+// and the version of the source from which it was generated. Each mesh
+// follows as its material name, padded to a multiple of four bytes, and its
+// vertex and element data.
+
+#define CACHE_MAGIC   0x48534D54
+#define CACHE_VERSION 1
+
+struct cache_header
+{
+    GLuint magic;
+    GLuint version;
+    GLuint center;
+    GLuint count;
+    GLuint source_len;
+    GLuint source_stamp;
+};
+
+static size_t pad4(size_t n)
+{
+    return (n + 3) & ~size_t(3);
+}
+
+//-----------------------------------------------------------------------------
+
+// Load the named surface, either immediately or on the loader thread. Either
+// way, a missing source is reported here.
+
+ogl::surface::surface(std::string name, bool center, bool async) :
+    name(name),
+    center(center),
+    cached(false),
+    ready(false),
+    source_len(0),
+    source_stamp(0),
+    task(this)
+{
+    if (async && ::loaders)
+    {
+        if (!::data->find(name))
+            throw app::find_error(name);
+
+        ::loaders->push(&task, &batch);
+    }
+    else
+    {
+        load(true);
+        ready = true;
+    }
+}
+
+ogl::surface::~surface()
+{
+    // Abandon or finish any background load before releasing the meshes.
+
+    if (!ready)
+    {
+        ::loaders->drop(&batch);
+        ::loaders->wait(&batch);
+    }
+
+    for (mesh_i i = meshes.begin(); i != meshes.end(); ++i)
+        delete (*i);
+}
+
+// Load the binary cache if it exists and matches the source. Otherwise parse
+// the source. Material bindings are optional, as they require the context.
+
+void ogl::surface::load(bool bind)
+{
+    if (::conf->get_i("surface_cache", 1) &&
+        ::data->stamp(name, &source_len, &source_stamp))
+        cached = load_cache(bind);
+
+    if (!cached)
+    {
+        obj::obj source(name, center, bind);
+        source.take_meshes(meshes);
+    }
+}
+
+// Background load. An unreadable source gives an empty surface.
+
+void ogl::surface::loader::run()
+{
+    try
+    {
+        s->load(false);
+
+        if (!s->cached)
+            s->save_cache();
+    }
+    catch (std::exception&)
+    {
+    }
+}
+
+// If a background load has completed, bind the materials of all meshes and
+// make them available. Return true if the surface has just become ready.
+
+bool ogl::surface::poll()
+{
+    if (!ready && ::loaders->done(&batch))
+    {
+        for (mesh_i i = meshes.begin(); i != meshes.end(); ++i)
+            (*i)->bind_material();
+
+        ready = true;
+        return true;
+    }
+    return false;
+}
+
+// Block until a background load completes and make the surface ready.
+
+void ogl::surface::wait()
+{
+    if (!ready)
+    {
+        ::loaders->wait(&batch);
+        poll();
+    }
+}
 
 //-----------------------------------------------------------------------------
 
+std::string ogl::surface::cache_name() const
+{
+    return name + ".mesh";
+}
+
+bool ogl::surface::load_cache(bool bind)
+{
+    const std::string path = cache_name();
+
+    if (!::data->find(path))
+        return false;
+
+    size_t      len = 0;
+    const char *ptr = (const char *) ::data->load(path, &len, false);
+    const char *end = ptr + len;
+
+    mesh_v v;
+    bool   ok = false;
+
+    // Confirm that the cache was generated from the current source.
+
+    cache_header h;
+
+    if (len >= sizeof (h))
+    {
+        memcpy(&h, ptr, sizeof (h));
+
+        if (h.magic        == CACHE_MAGIC   &&
+            h.version      == CACHE_VERSION &&
+            h.center       == GLuint(center)     &&
+            h.source_len   == GLuint(source_len) &&
+            h.source_stamp == GLuint(source_stamp))
+        {
+            const char *p = ptr + sizeof (h);
+
+            // Read each mesh, stopping short if the cache is truncated.
+
+            for (ok = true; ok && v.size() < h.count; )
+            {
+                GLuint n;
+
+                if (size_t(end - p) >= sizeof (n))
+                {
+                    memcpy(&n, p, sizeof (n));
+                    p += sizeof (n);
+                }
+                else break;
+
+                if (size_t(end - p) >= pad4(n))
+                {
+                    std::string material(p, n);
+                    p += pad4(n);
+
+                    mesh *m = material.empty() ? new mesh() : new mesh(material, bind);
+
+                    v.push_back(m);
+
+                    ok = (p = (const char *) m->read(p, end)) != 0;
+                }
+                else ok = false;
+            }
+            ok = ok && (v.size() == h.count);
+        }
+    }
+
+    ::data->free(path);
+
+    // Keep the meshes only if all were read.
+
+    if (ok)
+        meshes.swap(v);
+    else
+        for (mesh_i i = v.begin(); i != v.end(); ++i)
+            delete (*i);
+
+    return ok;
+}
+
+void ogl::surface::save_cache() const
+{
+    if (::conf->get_i("surface_cache", 1) && source_len)
+    {
+        // Determine the size of the cache.
+
+        size_t len = sizeof (cache_header);
+
+        for (mesh_c i = meshes.begin(); i != meshes.end(); ++i)
+            len += sizeof (GLuint) + pad4((*i)->get_name().size())
+                                   +      (*i)->write(0);
+
+        std::vector<char> buf(len, 0);
+
+        // Write the header.
+
+        cache_header h;
+
+        h.magic        = CACHE_MAGIC;
+        h.version      = CACHE_VERSION;
+        h.center       = GLuint(center);
+        h.count        = GLuint(meshes.size());
+        h.source_len   = GLuint(source_len);
+        h.source_stamp = GLuint(source_stamp);
+
+        char *p = &buf.front();
+
+        memcpy(p, &h, sizeof (h));
+        p += sizeof (h);
+
+        // Write each mesh.
+
+        for (mesh_c i = meshes.begin(); i != meshes.end(); ++i)
+        {
+            const std::string& material = (*i)->get_name();
+            const GLuint       n        = GLuint(material.size());
+
+            memcpy(p, &n, sizeof (n));
+            p += sizeof (n);
+            memcpy(p, material.data(), n);
+            p += pad4(n);
+            p += (*i)->write(p);
+        }
+
+        // Save the cache.  Failure is not fatal, merely slow.
+
+        try
+        {
+            ::data->save(cache_name(), &buf.front(), &len);
+        }
+        catch (std::runtime_error&)
+        {
+        }
+    }
+}
+
 //-----------------------------------------------------------------------------
@@ -10,11 +10,15 @@
 //  MERCHANTABILITY  or FITNESS  FOR A  PARTICULAR PURPOSE.   See  the GNU
 //  General Public License for more details.
 
+#include <cstdio>
 #include <stdexcept>
+#include <algorithm>
+#include <cmath>
 
 #include <png.h>
 
 #include <ogl-texture.hpp>
+#include <ogl-buffer.hpp>
 #include <app-file.hpp>
 #include <app-conf.hpp>
 #include <app-data.hpp>
@@ -23,15 +27,52 @@
 
 #define POT(n) (((n) & ((n) - 1)) == 0)
 
+#define FOURCC(a, b, c, d) (GLuint(a)       | (GLuint(b) <<  8) | \
+                            (GLuint(c) << 16) | (GLuint(d) << 24))
+
 //-----------------------------------------------------------------------------
 
-ogl::texture::texture(std::string name) : name(name), object(0), w(0), h(0), c(0)
+// With a proxy and a loader thread, create the texture object now and decode
+// the image in the background. Either way, a missing image is reported here.
+
+ogl::texture::texture(std::string name, const texture *proxy) :
+    name(name),
+    object(0),
+    w(0),
+    h(0),
+    c(0),
+    compressed(0),
+    proxy(proxy),
+    pbo(0),
+    next(0),
+    ready(false),
+    failed(false),
+    task(this)
 {
-    init();
+    if (proxy && ::loaders && ogl::context)
+    {
+        if (!::data->find("texture/" + name))
+            throw app::find_error(name);
+
+        glGenTextures(1, &object);
+        ::loaders->push(&task, &batch);
+    }
+    else
+    {
+        ready = true;
+        init();
+    }
 }
 
 ogl::texture::~texture()
 {
+    // Abandon or finish any background decode before releasing the texture.
+
+    if (!ready && ::loaders)
+    {
+        ::loaders->drop(&batch);
+        ::loaders->wait(&batch);
+    }
     fini();
 }
 
@@ -58,22 +99,317 @@ static void png_user_read(png_structp rp, png_bytep buf, png_size_t len)
 
 //-----------------------------------------------------------------------------
 
-static void downsample(GLsizei W, GLsizei H, GLsizei C, std::vector<GLubyte>& P)
+// Mipmaps are box filtered. Four-channel rows are filtered sixteen bytes at
+// a time where SSE2 is available, and the rows of large images are divided
+// among the worker threads. Filtering may be gamma-correct, averaging color
+// in linear space by table lookup, leaving alpha linear.
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define USE_SSE2
+#endif
+
+#define MIN_PARALLEL_PIXELS 65536
+
+struct gamma_table
+{
+    std::vector<GLushort> linear;
+    std::vector<GLubyte>  encode;
+
+    gamma_table(double g) : linear(256), encode(65536)
+    {
+        for (int i = 0; i < 256; ++i)
+            linear[i] = GLushort(pow(i / 255.0, g) * 65535.0 + 0.5);
+
+        for (int i = 0; i < 65536; ++i)
+            encode[i] = GLubyte(pow(i / 65535.0, 1.0 / g) * 255.0 + 0.5);
+    }
+};
+
+static void downsample_rows(const GLubyte *P, GLubyte *Q, GLsizei W, GLsizei C,
+                            GLsizei i0, GLsizei i1, const gamma_table *g)
 {
     const GLsizei w = W / 2;
-    const GLsizei h = H / 2;
 
-    for         (GLsizei i = 0; i < h; i++)
-        for     (GLsizei j = 0; j < w; j++)
-            for (GLsizei k = 0; k < C; k++)
+    for (GLsizei i = i0; i < i1; ++i)
+    {
+        const GLubyte *a = P + (2 * i + 0) * W * C;
+        const GLubyte *b = P + (2 * i + 1) * W * C;
+        GLubyte       *q = Q + (    i    ) * w * C;
+        GLsizei        j = 0;
+
+        if (g)
+        {
+            const GLsizei A = (C == 2 || C == 4) ? C - 1 : C;
+
+            for (; j < w; ++j, a += 2 * C, b += 2 * C, q += C)
+                for (GLsizei k = 0; k < C; ++k)
+                    if (k == A)
+                        q[k] = GLubyte((GLuint(a[k]) + a[k + C]
+                                            + b[k]  + b[k + C]) / 4);
+                    else
+                        q[k] = g->encode[(GLuint(g->linear[a[k]]) + g->linear[a[k + C]]
+                                                + g->linear[b[k]]  + g->linear[b[k + C]]) / 4];
+            continue;
+        }
+
+#ifdef USE_SSE2
+        // Sum each pair of rows in sixteen-bit lanes, then each pair of
+        // adjacent pixels, giving two output pixels per sixteen input bytes.
+
+        if (C == 4)
+        {
+            const __m128i z = _mm_setzero_si128();
+
+            for (; j + 2 <= w; j += 2, a += 16, b += 16, q += 8)
             {
-                GLuint b = GLuint(P[((2 * i + 0) * W + (2 * j + 0)) * C + k])
-                         + GLuint(P[((2 * i + 0) * W + (2 * j + 1)) * C + k])
-                         + GLuint(P[((2 * i + 1) * W + (2 * j + 0)) * C + k])
-                         + GLuint(P[((2 * i + 1) * W + (2 * j + 1)) * C + k]);
+                const __m128i x = _mm_loadu_si128((const __m128i *) a);
+                const __m128i y = _mm_loadu_si128((const __m128i *) b);
 
-                P[(i * w + j) * C + k] = GLubyte(b / 4);
+                __m128i l = _mm_add_epi16(_mm_unpacklo_epi8(x, z),
+                                          _mm_unpacklo_epi8(y, z));
+                __m128i h = _mm_add_epi16(_mm_unpackhi_epi8(x, z),
+                                          _mm_unpackhi_epi8(y, z));
+
+                l = _mm_add_epi16(l, _mm_srli_si128(l, 8));
+                h = _mm_add_epi16(h, _mm_srli_si128(h, 8));
+
+                __m128i r = _mm_srli_epi16(_mm_unpacklo_epi64(l, h), 2);
+
+                _mm_storel_epi64((__m128i *) q, _mm_packus_epi16(r, r));
             }
+        }
+#endif
+        for (; j < w; ++j, a += 2 * C, b += 2 * C, q += C)
+            for (GLsizei k = 0; k < C; ++k)
+                q[k] = GLubyte((GLuint(a[k]) + a[k + C] + b[k] + b[k + C]) / 4);
+    }
+}
+
+namespace ogl
+{
+    class downsample_task : public etc::task
+    {
+    public:
+
+        downsample_task(const GLubyte *P, GLubyte *Q, GLsizei W, GLsizei C,
+                        GLsizei i0, GLsizei i1, const gamma_table *g)
+            : P(P), Q(Q), W(W), C(C), i0(i0), i1(i1), g(g) { }
+
+        void run()
+        {
+            downsample_rows(P, Q, W, C, i0, i1, g);
+        }
+
+    private:
+
+        const GLubyte     *P;
+        GLubyte           *Q;
+        GLsizei            W;
+        GLsizei            C;
+        GLsizei            i0;
+        GLsizei            i1;
+        const gamma_table *g;
+    };
+
+    typedef std::vector<downsample_task> downsample_task_v;
+}
+
+static void downsample(GLsizei W, GLsizei H, GLsizei C,
+                       const std::vector<GLubyte>& P,
+                             std::vector<GLubyte>& Q, const gamma_table *g)
+{
+    const GLsizei w = W / 2;
+    const GLsizei h = H / 2;
+
+    Q.resize(w * h * C);
+
+    if (Q.empty()) return;
+
+    // Divide the rows among the workers if worthwhile.
+
+    if (::workers && ::workers->size() && w * h > MIN_PARALLEL_PIXELS)
+    {
+        const int m = std::min(::workers->size() + 1, int(h));
+
+        ogl::downsample_task_v tasks;
+        etc::batch             batch;
+
+        for (int i = 0; i < m; ++i)
+            tasks.push_back(ogl::downsample_task(&P.front(), &Q.front(), W, C,
+                                                 h * i / m, h * (i + 1) / m, g));
+
+        for (ogl::downsample_task_v::iterator i = tasks.begin(); i != tasks.end(); ++i)
+            ::workers->push(&(*i), &batch);
+
+        ::workers->wait(&batch);
+    }
+    else downsample_rows(&P.front(), &Q.front(), W, C, 0, h, g);
+}
+
+// Scale the channels of a mipmap as glPixelTransfer would, with luminance
+// taking the red scale.
+
+static void rescale(std::vector<GLubyte>& P, GLsizei C, const vec4& s)
+{
+    static const int channel[4][4] = {
+        { 0 }, { 0, 3 }, { 0, 1, 2 }, { 0, 1, 2, 3 }
+    };
+
+    GLubyte lut[4][256];
+
+    for     (GLsizei k = 0; k < C;   ++k)
+        for (int     v = 0; v < 256; ++v)
+            lut[k][v] = GLubyte(std::min(std::max(v * s[channel[C - 1][k]] + 0.5,
+                                                  0.0), 255.0));
+
+    for (size_t i = 0; i < P.size(); i += C)
+        for (GLsizei k = 0; k < C; ++k)
+            P[i + k] = lut[k][P[i + k]];
+}
+
+static GLenum format(GLsizei c)
+{
+    switch (c)
+    {
+        case 1:  return GL_LUMINANCE;
+        case 2:  return GL_LUMINANCE_ALPHA;
+        case 3:  return GL_RGB;
+        default: return GL_RGBA;
+    }
+}
+
+// Determine the block size and channel count of a compressed format. Return
+// false if the format is unknown or unsupported. A channel count of three
+// indicates opacity, as two-channel formats hold normals, not alpha.
+
+static bool block_format(GLenum f, GLsizei& b, GLsizei& c)
+{
+    switch (f)
+    {
+        case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:  b =  8; c = 3; return ogl::has_s3tc;
+        case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT: b =  8; c = 4; return ogl::has_s3tc;
+        case GL_COMPRESSED_RGBA_S3TC_DXT3_EXT: b = 16; c = 4; return ogl::has_s3tc;
+        case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT: b = 16; c = 4; return ogl::has_s3tc;
+        case GL_COMPRESSED_RED_RGTC1:          b =  8; c = 1; return ogl::has_rgtc;
+        case GL_COMPRESSED_RG_RGTC2:           b = 16; c = 3; return ogl::has_rgtc;
+        case GL_COMPRESSED_RGBA_BPTC_UNORM:    b = 16; c = 4; return ogl::has_bptc;
+    }
+    return false;
+}
+
+static GLuint get32(const GLubyte *p)
+{
+    return GLuint(p[0])       | (GLuint(p[1]) <<  8)
+        | (GLuint(p[2]) << 16) | (GLuint(p[3]) << 24);
+}
+
+//-----------------------------------------------------------------------------
+
+// Reverse the first k rows of a block of one byte per row, as in the color
+// indices of BC1, or of two bytes per row, as in the explicit alpha of BC2.
+
+static void flip_bytes(GLubyte *p, int k, int n)
+{
+    for (int i = 0, j = k - 1; i < j; ++i, --j)
+        for (int l = 0; l < n; ++l)
+            std::swap(p[i * n + l], p[j * n + l]);
+}
+
+// Reverse the first k rows of the 48 bits of 3-bit indices of a BC4 block,
+// as also used by the alpha of BC3 and both channels of BC5.
+
+static void flip_bc4(GLubyte *p, int k)
+{
+    unsigned long long b = 0;
+    unsigned long long r[4];
+
+    for (int i = 0; i < 6; ++i) b |= (unsigned long long) p[i + 2] << (8 * i);
+    for (int i = 0; i < 4; ++i) r[i] = (b >> (12 * i)) & 0xFFF;
+
+    for (int i = 0, j = k - 1; i < j; ++i, --j)
+        std::swap(r[i], r[j]);
+
+    b = 0;
+
+    for (int i = 0; i < 4; ++i) b |= r[i] << (12 * i);
+    for (int i = 0; i < 6; ++i) p[i + 2] = GLubyte(b >> (8 * i));
+}
+
+// Determine whether a compressed image of height h may be flipped. An image
+// taller than a block must fill its blocks exactly, and BC7 cannot be flipped
+// within the block at all.
+
+static bool flippable(GLenum f, GLsizei h)
+{
+    return f != GL_COMPRESSED_RGBA_BPTC_UNORM && (h <= 4 || h % 4 == 0);
+}
+
+// Flip a compressed image of w by h pixels vertically, converting top-down
+// container order to OpenGL order. Block rows are reversed, as are the first
+// k pixel rows within each block.
+
+static void flip_blocks(GLenum f, GLsizei b, GLsizei w, GLsizei h,
+                        std::vector<GLubyte>& p)
+{
+    const GLsizei bw = (w + 3) / 4;
+    const GLsizei bh = (h + 3) / 4;
+    const int     k  = std::min(h, 4);
+    const size_t  s  = size_t(bw) * b;
+
+    for (GLsizei i = 0, j = bh - 1; i < j; ++i, --j)
+        std::swap_ranges(p.begin() + i * s, p.begin() + i * s + s,
+                         p.begin() + j * s);
+
+    for (size_t o = 0; o + b <= p.size(); o += b)
+        switch (f)
+        {
+            case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+            case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT:
+                flip_bytes(&p[o + 4], k, 1);
+                break;
+            case GL_COMPRESSED_RGBA_S3TC_DXT3_EXT:
+                flip_bytes(&p[o + 0], k, 2);
+                flip_bytes(&p[o + 12], k, 1);
+                break;
+            case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+                flip_bc4  (&p[o + 0], k);
+                flip_bytes(&p[o + 12], k, 1);
+                break;
+            case GL_COMPRESSED_RED_RGTC1:
+                flip_bc4  (&p[o + 0], k);
+                break;
+            case GL_COMPRESSED_RG_RGTC2:
+                flip_bc4  (&p[o + 0], k);
+                flip_bc4  (&p[o + 8], k);
+                break;
+        }
+}
+
+// Determine whether a KTX file declares top-down row order in its key-value
+// data. Absent that, rows are in OpenGL order.
+
+static bool ktx_top_down(const GLubyte *p, size_t len)
+{
+    const size_t n = std::min(size_t(64 + get32(p + 60)), len);
+    const char  *k = "KTXorientation";
+
+    for (size_t o = 64; o + 4 <= n; )
+    {
+        const size_t s = get32(p + o);
+        const char  *v = (const char *) p + o + 4;
+
+        if (o + 4 + s > n) break;
+
+        if (s > strlen(k) + 1 && strcmp(v, k) == 0)
+        {
+            const std::string t(v + strlen(k) + 1, s - strlen(k) - 1);
+
+            return t.find("T=d") != std::string::npos;
+        }
+        o += 4 + ((s + 3) & ~size_t(3));
+    }
+    return false;
 }
 
 //-----------------------------------------------------------------------------
@@ -135,6 +471,186 @@ void ogl::texture::load_png(const void *buf, size_t len, std::vector<GLubyte>& p
 
 //-----------------------------------------------------------------------------
 
+// Flip all top-down mipmap levels of format f and block size b into OpenGL
+// order. If any one of them cannot be flipped then none is, so that all levels
+// agree, and the texture appears upside down. BC7 and heights that do not fill
+// their blocks should be baked bottom-up into a KTX, as png2dds does.
+
+void ogl::texture::flip_levels(GLenum f, GLsizei b)
+{
+    for (size_t l = 0; l < levels.size(); ++l)
+        if (!flippable(f, levels[l].h))
+        {
+            fprintf(stderr, "%s: Top-down level %d cannot be flipped\n",
+                    name.c_str(), int(l));
+            return;
+        }
+
+    for (size_t l = 0; l < levels.size(); ++l)
+        flip_blocks(f, b, levels[l].w, levels[l].h, levels[l].p);
+}
+
+// A DDS holds rows from top to bottom, and its mipmap levels are flipped into
+// OpenGL order. A KTX holds rows in OpenGL order unless its orientation says
+// otherwise.
+
+bool ogl::texture::load_dds(const void *buf, size_t len)
+{
+    const GLubyte *p = (const GLubyte *) buf;
+
+    if (len < 128 || get32(p) != FOURCC('D', 'D', 'S', ' ')
+                  || get32(p + 4) != 124)
+        return false;
+
+    GLsizei W = GLsizei(get32(p + 16));
+    GLsizei H = GLsizei(get32(p + 12));
+    GLsizei n = GLsizei(get32(p + 28));
+    GLuint  a = get32(p + 80) & 0x1;
+    GLuint  f = get32(p + 84);
+    size_t  o = 128;
+    GLenum  e = 0;
+
+    // Map the four-character code or the DXGI format to an OpenGL format.
+
+    if (f == FOURCC('D', 'X', '1', '0'))
+    {
+        if (len < 148) return false;
+
+        switch (get32(p + 128))
+        {
+            case 71: case 72: e = GL_COMPRESSED_RGB_S3TC_DXT1_EXT;  break;
+            case 74: case 75: e = GL_COMPRESSED_RGBA_S3TC_DXT3_EXT; break;
+            case 77: case 78: e = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT; break;
+            case 80:          e = GL_COMPRESSED_RED_RGTC1;          break;
+            case 83:          e = GL_COMPRESSED_RG_RGTC2;           break;
+            case 98: case 99: e = GL_COMPRESSED_RGBA_BPTC_UNORM;    break;
+        }
+        o = 148;
+    }
+    else
+    {
+        if (f == FOURCC('D', 'X', 'T', '1'))
+            e = a ? GL_COMPRESSED_RGBA_S3TC_DXT1_EXT
+                  : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+        if (f == FOURCC('D', 'X', 'T', '3')) e = GL_COMPRESSED_RGBA_S3TC_DXT3_EXT;
+        if (f == FOURCC('D', 'X', 'T', '5')) e = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+        if (f == FOURCC('A', 'T', 'I', '1')) e = GL_COMPRESSED_RED_RGTC1;
+        if (f == FOURCC('B', 'C', '4', 'U')) e = GL_COMPRESSED_RED_RGTC1;
+        if (f == FOURCC('A', 'T', 'I', '2')) e = GL_COMPRESSED_RG_RGTC2;
+        if (f == FOURCC('B', 'C', '5', 'U')) e = GL_COMPRESSED_RG_RGTC2;
+    }
+
+    GLsizei b;
+    GLsizei C;
+
+    if (!block_format(e, b, C) || W <= 0 || H <= 0)
+        return false;
+
+    // Gather the mipmap levels, which are contiguous.
+
+    levels.clear();
+
+    for (GLsizei l = 0; l < std::max(n, 1); ++l)
+    {
+        const GLsizei ww = std::max(W >> l, 1);
+        const GLsizei hh = std::max(H >> l, 1);
+        const size_t  s  = size_t((ww + 3) / 4) * size_t((hh + 3) / 4) * b;
+
+        if (o + s > len) break;
+
+        levels.push_back(level());
+        levels.back().w = ww;
+        levels.back().h = hh;
+        levels.back().p.assign(p + o, p + o + s);
+
+        o += s;
+    }
+    flip_levels(e, b);
+
+    w = W;
+    h = H;
+    c = C;
+    compressed = e;
+
+    return !levels.empty();
+}
+
+bool ogl::texture::load_ktx(const void *buf, size_t len)
+{
+    static const GLubyte id[12] = {
+        0xAB, 0x4B, 0x54, 0x58, 0x20, 0x31, 0x31, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A
+    };
+
+    const GLubyte *p = (const GLubyte *) buf;
+
+    if (len < 64 || memcmp(p, id, 12) || get32(p + 12) != 0x04030201)
+        return false;
+
+    GLenum  e = GLenum (get32(p + 28));
+    GLsizei W = GLsizei(get32(p + 36));
+    GLsizei H = GLsizei(get32(p + 40));
+    GLsizei n = GLsizei(get32(p + 56));
+    size_t  o = 64 +   get32(p + 60);
+
+    // Accept only single two-dimensional images.
+
+    GLsizei b;
+    GLsizei C;
+
+    if (!block_format(e, b, C) || W <= 0 || H <= 0 || get32(p + 44)
+                                                   || get32(p + 48)
+                                                   || get32(p + 52) != 1)
+        return false;
+
+    // Gather the mipmap levels, each preceded by its size and padded.
+
+    const bool flip = ktx_top_down(p, len);
+
+    levels.clear();
+
+    for (GLsizei l = 0; l < std::max(n, 1) && o + 4 <= len; ++l)
+    {
+        const size_t s = get32(p + o);
+
+        if ((o += 4) + s > len) break;
+
+        levels.push_back(level());
+        levels.back().w = std::max(W >> l, 1);
+        levels.back().h = std::max(H >> l, 1);
+        levels.back().p.assign(p + o, p + o + s);
+
+        o += (s + 3) & ~size_t(3);
+    }
+    if (flip) flip_levels(e, b);
+
+    w = W;
+    h = H;
+    c = C;
+    compressed = e;
+
+    return !levels.empty();
+}
+
+// Load the named compressed container, if it exists and is supported.
+
+bool ogl::texture::load_cmp(std::string name)
+{
+    bool ok = false;
+
+    if (::data->find(name))
+    {
+        size_t      len = 0;
+        const void *buf = ::data->load(name, &len, false);
+
+        ok = buf && (load_dds(buf, len) || load_ktx(buf, len));
+
+        ::data->free(name);
+    }
+    return ok;
+}
+
+//-----------------------------------------------------------------------------
+
 static GLenum wrap_key(const std::string& name)
 {
     if (!name.empty())
@@ -184,7 +700,8 @@ static GLint filter_val(const std::string& name)
 
 //-----------------------------------------------------------------------------
 
-void ogl::texture::load_opt(std::string name, std::map<int, vec4>& scale)
+void ogl::texture::load_opt(std::string name, std::map<int, vec4>& scale,
+                                              double& gamma)
 {
     // Convert the image name to an XML parameter file name.
 
@@ -214,6 +731,8 @@ void ogl::texture::load_opt(std::string name, std::map<int, vec4>& scale)
 
                     scale[l] = vec4(r, g, b, a);
                 }
+                if ("gamma" == n.get_s("name"))
+                    gamma = n.get_f("value", 1);
             }
         }
     }
@@ -235,129 +754,270 @@ void ogl::texture::load_prm(std::string name)
 
         if (app::node p = file.get_root().find("texture"))
         {
-            // Parse and apply wrap modes.
+            // Parse wrap modes.
 
             for (app::node n = p.find("wrap"); n; n = p.next(n, "wrap"))
             {
                 GLenum key = wrap_key(n.get_s("axis"));
                 GLenum val = wrap_val(n.get_s("value"));
 
-                if (key && val) glTexParameteri(GL_TEXTURE_2D, key, val);
+                if (key && val) params.push_back(param(key, val));
             }
 
-            // Parse and apply filter modes.
+            // Parse filter modes.
 
             for (app::node n = p.find("filter"); n; n = p.next(n, "filter"))
             {
                 GLenum key = filter_key(n.get_s("type"));
                 GLenum val = filter_val(n.get_s("value"));
 
-                if (key && val) glTexParameteri(GL_TEXTURE_2D, key, val);
+                if (key && val) params.push_back(param(key, val));
             }
         }
     }
 }
 
-void ogl::texture::load_img(std::string name, std::map<int, vec4>& scale)
+void ogl::texture::load_img(std::string name, std::map<int, vec4>& scale,
+                                              double  gamma)
 {
     std::vector<GLubyte> pixels;
 
     // Load and parse the data file.
 
     size_t      len;
-    const void *buf = ::data->load(name, &len);
+    const void *buf = ::data->load(name, &len, false);
 
     if (buf) load_png(buf, len, pixels);
 
     ::data->free(name);
 
-    // Initialize the OpenGL texture object.
+    // Enumerate the mipmap levels, keeping each for upload.
 
-    GLenum f = GL_RGBA;
+    gamma_table *g = (gamma != 1) ? new gamma_table(gamma) : 0;
 
-    switch (c)
+    GLsizei ww = w;
+    GLsizei hh = h;
+
+    levels.clear();
+    compressed = 0;
+
+    for (GLint l = 0; ww > 0 && hh > 0; l++)
     {
-        case 1: f = GL_LUMINANCE;
-        case 2: f = GL_LUMINANCE_ALPHA;
-        case 3: f = GL_RGB;
+        levels.push_back(level());
+        levels.back().w = ww;
+        levels.back().h = hh;
+
+        if (l == 0)
+            levels.back().p.swap(pixels);
+        else
+            downsample(levels[l - 1].w,
+                       levels[l - 1].h, c, levels[l - 1].p, levels.back().p, g);
+
+        ww /= 2;
+        hh /= 2;
     }
+    delete g;
 
-    ogl::bind_texture(GL_TEXTURE_2D, GL_TEXTURE0, object);
+    // Apply the scale of each mipmap, now that all are filtered.
 
-    GLubyte *p = &pixels.front();
-    GLsizei ww = w;
-    GLsizei hh = h;
+    for (std::map<int, vec4>::iterator it = scale.begin(); it != scale.end(); ++it)
+        if (it->first >= 0 && it->first < int(levels.size()))
+            rescale(levels[it->first].p, c, it->second);
+}
 
-    // Enumerate the mipmap levels.
+// Read the image and its parameters. This may be called on any thread.
 
-    for (GLint l = 0; ww > 0 && hh > 0; l++)
+void ogl::texture::decode()
+{
+    std::string path = "texture/" + name;
+    std::string base(path, 0, path.rfind("."));
+
+    std::map<int, vec4> scale;
+    double              gamma = 1;
+
+    params.clear();
+
+    load_opt(path, scale, gamma);
+
+    if (!load_cmp(base + ".ktx") && !load_cmp(base + ".dds"))
+        load_img(path, scale, gamma);
+
+    load_prm(path);
+}
+
+void ogl::texture::loader::run()
+{
+    try
+    {
+        t->decode();
+    }
+    catch (std::exception& e)
     {
-        std::map<int, vec4>::iterator it;
+        fprintf(stderr, "%s: %s\n", t->name.c_str(), e.what());
+        t->levels.clear();
+    }
+}
 
-        // Set the scale for this mipmap.
+//-----------------------------------------------------------------------------
 
-        if ((it = scale.find(l)) == scale.end())
-        {
-            glPixelTransferf(GL_RED_SCALE,   1.f);
-            glPixelTransferf(GL_GREEN_SCALE, 1.f);
-            glPixelTransferf(GL_BLUE_SCALE,  1.f);
-            glPixelTransferf(GL_ALPHA_SCALE, 1.f);
-        }
-        else
+// Copy the pixels of the given mipmap level to the bound texture, through a
+// pixel buffer where possible, so that the transfer need not stall.
+
+void ogl::texture::upload(size_t l)
+{
+    const level& v = levels[l];
+    const GLenum f = format(c);
+    const GLint  i = GLint(l);
+
+    const GLvoid *p = &v.p.front();
+
+    // Stage the pixels in the pixel buffer, if possible.
+
+    if (ogl::has_pixel_buffer)
+    {
+        if (pbo == 0)
+            pbo = new ogl::buffer(GL_PIXEL_UNPACK_BUFFER,
+                                  GLsizei(levels.front().p.size()),
+                                  GL_STREAM_DRAW);
+        pbo->bind();
+        pbo->zero();
+
+        if (void *q = pbo->wmap())
         {
-            glPixelTransferf(GL_RED_SCALE,   GLfloat(it->second[0]));
-            glPixelTransferf(GL_GREEN_SCALE, GLfloat(it->second[1]));
-            glPixelTransferf(GL_BLUE_SCALE,  GLfloat(it->second[2]));
-            glPixelTransferf(GL_ALPHA_SCALE, GLfloat(it->second[3]));
+            memcpy(q, p, v.p.size());
+            pbo->umap();
+            p = 0;
         }
+        else pbo->free();
+    }
 
-        // Copy the pixels.
+    // Copy the pixels, compressing them if requested.
 
-        glTexImage2D(GL_TEXTURE_2D, l, f, ww, hh, 0, f, GL_UNSIGNED_BYTE, p);
+    if (compressed)
+        glCompressedTexImage2D(GL_TEXTURE_2D, i, compressed, v.w, v.h, 0,
+                               GLsizei(v.p.size()), p);
+    else
+    {
+        GLenum e = f;
 
-        // Prepare for the next mipmap level.
+        if (ogl::do_texture_compression)
+            e = (c == 1 || c == 3) ? GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+                                   : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
 
-        downsample(ww, hh, c, pixels);
-        ww /= 2;
-        hh /= 2;
+        glTexImage2D(GL_TEXTURE_2D, i, e, v.w, v.h, 0, f, GL_UNSIGNED_BYTE, p);
     }
 
-    // Initialize the default texture parameters.
+    if (p == 0) pbo->free();
+}
+
+// Apply the texture parameters and release the decoded image.
 
+void ogl::texture::finish()
+{
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
 
     if (ogl::has_anisotropic)
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_ANISOTROPY_EXT,
                                                 ogl::max_anisotropy);
+
+    for (std::vector<param>::iterator i = params.begin(); i != params.end(); ++i)
+        glTexParameteri(GL_TEXTURE_2D, i->first, i->second);
+
+    // A chain that stops short of 1x1 is complete only if its end is given.
+
+    if (!levels.empty())
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL,
+                        GLint(levels.size()) - 1);
+
+    std::vector<level>().swap(levels);
+
+    delete pbo;
+    pbo  = 0;
+    next = 0;
+}
+
+// If a background decode has completed, upload mipmap levels until the given
+// number of bytes is exceeded, and become ready once all are uploaded. Always
+// upload at least one level. Return the number of bytes uploaded.
+
+size_t ogl::texture::poll(size_t budget)
+{
+    size_t n = 0;
+
+    if (!ready && !failed && ::loaders->done(&batch))
+    {
+        // A decode that produced nothing has failed.  Keep the proxy.
+
+        if (levels.empty())
+        {
+            fprintf(stderr, "Failed to load texture %s\n", name.c_str());
+            failed = true;
+            return 0;
+        }
+
+        ogl::bind_texture(GL_TEXTURE_2D, GL_TEXTURE0, object);
+
+        while (next < levels.size() && (n == 0 || n < budget))
+        {
+            n += levels[next].p.size();
+            upload(next++);
+        }
+
+        if (next == levels.size())
+        {
+            finish();
+            ready = true;
+        }
+    }
+    return n;
 }
 
 //-----------------------------------------------------------------------------
 
 void ogl::texture::bind(GLenum unit) const
 {
-    ogl::bind_texture(GL_TEXTURE_2D, unit, object);
+    ogl::bind_texture(GL_TEXTURE_2D, unit, (ready || !proxy) ? object
+                                                             : proxy->object);
 }
 
 void ogl::texture::free(GLenum unit) const
 {
 }
 
+// Until loaded, a texture takes the opacity of its proxy.
+
+bool ogl::texture::opaque() const
+{
+    if (ready || !proxy)
+        return (c == 1 || c == 3);
+    else
+        return proxy->opaque();
+}
+
 //-----------------------------------------------------------------------------
 
+// A loaded texture is reloaded in full. A texture still loading restarts its
+// upload once its decode is complete.
+
 void ogl::texture::init()
 {
     if (ogl::context)
     {
-        std::map<int, vec4> scale;
+        glGenTextures(1, &object);
+
+        if (ready)
+        {
+            decode();
 
-        std::string path = "texture/" + name;
+            ogl::bind_texture(GL_TEXTURE_2D, GL_TEXTURE0, object);
 
-        glGenTextures(1, &object);
+            for (size_t l = 0; l < levels.size(); ++l)
+                upload(l);
 
-        load_opt(path, scale);
-        load_img(path, scale);
-        load_prm(path);
+            finish();
+        }
+        else next = 0;
     }
 }
 
@@ -365,8 +1025,11 @@ void ogl::texture::fini()
 {
     if (ogl::context)
     {
-        glDeleteTextures(1, &object);
+        ogl::dele_texture(object);
         object = 0;
+
+        delete pbo;
+        pbo = 0;
     }
 }
 
@@ -10,15 +10,20 @@
 //  MERCHANTABILITY  or FITNESS  FOR A  PARTICULAR PURPOSE.   See  the GNU
 //  General Public License for more details.
 
+#include <algorithm>
 #include <cassert>
+#include <cstring>
 
 #include <ogl-uniform.hpp>
 
 //-----------------------------------------------------------------------------
 
-ogl::uniform::uniform(std::string name, GLsizei len) : name(name), len(len)
+ogl::uniform::uniform(std::string name, GLsizei len) :
+    name(name), len(len), version(1)
 {
     val = new GLfloat[len];
+
+    std::fill(val, val + len, 0.0f);
 }
 
 ogl::uniform::~uniform()
@@ -28,73 +33,108 @@ ogl::uniform::~uniform()
 
 //-----------------------------------------------------------------------------
 
+// Store a new value, counting a new version only if the value has changed.
+
+void ogl::uniform::store(const GLfloat *v, GLsizei n)
+{
+    if (memcmp(val, v, n * sizeof (GLfloat)))
+    {
+        memcpy(val, v, n * sizeof (GLfloat));
+        version++;
+    }
+}
+
 void ogl::uniform::set(double a)
 {
-    val[0] = GLfloat(a);
+    GLfloat v[1];
+
+    v[0] = GLfloat(a);
+
+    store(v, 1);
 }
 
 void ogl::uniform::set(const vec2& v)
 {
     assert(len == 2);
 
-    val[0] = GLfloat(v[0]);
-    val[1] = GLfloat(v[1]);
+    GLfloat T[2];
+
+    T[0] = GLfloat(v[0]);
+    T[1] = GLfloat(v[1]);
+
+    store(T, 2);
 }
 
 void ogl::uniform::set(const vec3& v)
 {
     assert(len == 3);
 
-    val[0] = GLfloat(v[0]);
-    val[1] = GLfloat(v[1]);
-    val[2] = GLfloat(v[2]);
+    GLfloat T[3];
+
+    T[0] = GLfloat(v[0]);
+    T[1] = GLfloat(v[1]);
+    T[2] = GLfloat(v[2]);
+
+    store(T, 3);
 }
 
 void ogl::uniform::set(const vec4& v)
 {
     assert(len == 4);
 
-    val[0] = GLfloat(v[0]);
-    val[1] = GLfloat(v[1]);
-    val[2] = GLfloat(v[2]);
-    val[3] = GLfloat(v[3]);
+    GLfloat T[4];
+
+    T[0] = GLfloat(v[0]);
+    T[1] = GLfloat(v[1]);
+    T[2] = GLfloat(v[2]);
+    T[3] = GLfloat(v[3]);
+
+    store(T, 4);
 }
 
 void ogl::uniform::set(const mat3& M)
 {
     assert(len == 9);
 
-    val[0] = GLfloat(M[0][0]);
-    val[1] = GLfloat(M[1][0]);
-    val[2] = GLfloat(M[2][0]);
-    val[3] = GLfloat(M[0][1]);
-    val[4] = GLfloat(M[1][1]);
-    val[5] = GLfloat(M[2][1]);
-    val[6] = GLfloat(M[0][2]);
-    val[7] = GLfloat(M[1][2]);
-    val[8] = GLfloat(M[2][2]);
+    GLfloat T[9];
+
+    T[0] = GLfloat(M[0][0]);
+    T[1] = GLfloat(M[1][0]);
+    T[2] = GLfloat(M[2][0]);
+    T[3] = GLfloat(M[0][1]);
+    T[4] = GLfloat(M[1][1]);
+    T[5] = GLfloat(M[2][1]);
+    T[6] = GLfloat(M[0][2]);
+    T[7] = GLfloat(M[1][2]);
+    T[8] = GLfloat(M[2][2]);
+
+    store(T, 9);
 }
 
 void ogl::uniform::set(const mat4& M)
 {
     assert(len == 16);
 
-    val[ 0] = GLfloat(M[0][0]);
-    val[ 1] = GLfloat(M[1][0]);
-    val[ 2] = GLfloat(M[2][0]);
-    val[ 3] = GLfloat(M[3][0]);
-    val[ 4] = GLfloat(M[0][1]);
-    val[ 5] = GLfloat(M[1][1]);
-    val[ 6] = GLfloat(M[2][1]);
-    val[ 7] = GLfloat(M[3][1]);
-    val[ 8] = GLfloat(M[0][2]);
-    val[ 9] = GLfloat(M[1][2]);
-    val[10] = GLfloat(M[2][2]);
-    val[11] = GLfloat(M[3][2]);
-    val[12] = GLfloat(M[0][3]);
-    val[13] = GLfloat(M[1][3]);
-    val[14] = GLfloat(M[2][3]);
-    val[15] = GLfloat(M[3][3]);
+    GLfloat T[16];
+
+    T[ 0] = GLfloat(M[0][0]);
+    T[ 1] = GLfloat(M[1][0]);
+    T[ 2] = GLfloat(M[2][0]);
+    T[ 3] = GLfloat(M[3][0]);
+    T[ 4] = GLfloat(M[0][1]);
+    T[ 5] = GLfloat(M[1][1]);
+    T[ 6] = GLfloat(M[2][1]);
+    T[ 7] = GLfloat(M[3][1]);
+    T[ 8] = GLfloat(M[0][2]);
+    T[ 9] = GLfloat(M[1][2]);
+    T[10] = GLfloat(M[2][2]);
+    T[11] = GLfloat(M[3][2]);
+    T[12] = GLfloat(M[0][3]);
+    T[13] = GLfloat(M[1][3]);
+    T[14] = GLfloat(M[2][3]);
+    T[15] = GLfloat(M[3][3]);
+
+    store(T, 16);
 }
 
 //-----------------------------------------------------------------------------
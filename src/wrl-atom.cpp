@@ -47,9 +47,11 @@ wrl::atom::atom(app::node node, std::string _fill_name,
     line(0),
     fill_name(_fill_name),
     line_name(_line_name),
+    fill_ubiq(false),
     line_scale(1, 1, 1)
 {
-    // Load the named file and line units.
+    // Load the named file and line units, in the background if possible. A
+    // solid sized by the bound of its file unit waits for it.
 
     if (fill_name.empty() && node)
         fill_name = node.find("file").get_s();
@@ -59,9 +61,9 @@ wrl::atom::atom(app::node node, std::string _fill_name,
         line_name = line_from_fill(fill_name);
 
     if (!fill_name.empty())
-        fill = new ogl::unit(fill_name);
+        fill = new ogl::unit(fill_name, true, true);
     if (!line_name.empty())
-        line = new ogl::unit(line_name);
+        line = new ogl::unit(line_name, true, true);
 
     // Initialize the transform and body mappings.
 
@@ -160,6 +162,47 @@ void wrl::atom::dead(dSpaceID space) const
 
 //-----------------------------------------------------------------------------
 
+// An atom held only by the undo history needs none of its GL state. Stowing
+// deletes its units, leaving the names, transform, and parameters from which
+// unstowing reloads them.
+
+void wrl::atom::stow()
+{
+    if (fill)
+    {
+        fill_ubiq = fill->is_ubiq();
+        delete fill;
+        fill = 0;
+    }
+    if (line)
+    {
+        delete line;
+        line = 0;
+    }
+}
+
+void wrl::atom::unstow()
+{
+    if (fill == 0 && !fill_name.empty())
+    {
+        fill = new ogl::unit(fill_name, true, true);
+        fill->set_ubiq(fill_ubiq);
+    }
+    if (line == 0 && !line_name.empty())
+        line = new ogl::unit(line_name, true, true);
+}
+
+// Approximate the memory held by a stowed atom, which has no units.
+
+size_t wrl::atom::get_size() const
+{
+    return sizeof (*this) + fill_name.size()
+                          + line_name.size()
+                          + params.size() * sizeof (param);
+}
+
+//-----------------------------------------------------------------------------
+
 dGeomID wrl::atom::init_edit_geom(dSpaceID space)
 {
     if ((edit_geom = new_edit_geom(space)))
@@ -24,6 +24,26 @@ namespace wrl
     static wrl::atom_set deselection;
 }
 
+// Approximate the heap cost of one atom set or map node, and of the atoms of
+// a set held only by the history.
+
+static const size_t node_size = sizeof (wrl::atom *) + 4 * sizeof (void *);
+
+static size_t atom_size(const wrl::atom_set& set)
+{
+    size_t s = 0;
+
+    for (wrl::atom_set::const_iterator i = set.begin(); i != set.end(); ++i)
+        s += (*i)->get_size();
+
+    return s;
+}
+
+size_t wrl::operation::size() const
+{
+    return sizeof (*this) + selection.size() * node_size;
+}
+
 //-----------------------------------------------------------------------------
 
 wrl::create_op::create_op(wrl::atom_set& S) : operation(S)
@@ -45,18 +65,34 @@ wrl::create_op::~create_op()
 
 wrl::atom_set& wrl::create_op::undo(wrl::world *w)
 {
+    wrl::atom_set::iterator i;
+
     w->delete_set(selection);
+
+    for (i = selection.begin(); i != selection.end(); ++i)
+        (*i)->stow();
+
     done = false;
     return deselection;
 }
 
 wrl::atom_set& wrl::create_op::redo(wrl::world *w)
 {
+    wrl::atom_set::iterator i;
+
+    for (i = selection.begin(); i != selection.end(); ++i)
+        (*i)->unstow();
+
     w->create_set(selection);
     done = true;
     return selection;
 }
 
+size_t wrl::create_op::size() const
+{
+    return operation::size() + (done ? 0 : atom_size(selection));
+}
+
 //-----------------------------------------------------------------------------
 
 wrl::delete_op::delete_op(wrl::atom_set& S) : operation(S)
@@ -78,6 +114,11 @@ wrl::delete_op::~delete_op()
 
 wrl::atom_set& wrl::delete_op::undo(wrl::world *w)
 {
+    wrl::atom_set::iterator i;
+
+    for (i = selection.begin(); i != selection.end(); ++i)
+        (*i)->unstow();
+
     w->create_set(selection);
     done = false;
     return selection;
@@ -85,11 +126,22 @@ wrl::atom_set& wrl::delete_op::undo(wrl::world *w)
 
 wrl::atom_set& wrl::delete_op::redo(wrl::world *w)
 {
+    wrl::atom_set::iterator i;
+
     w->delete_set(selection);
+
+    for (i = selection.begin(); i != selection.end(); ++i)
+        (*i)->stow();
+
     done = true;
     return deselection;
 }
 
+size_t wrl::delete_op::size() const
+{
+    return operation::size() + (done ? atom_size(selection) : 0);
+}
+
 //-----------------------------------------------------------------------------
 
 wrl::modify_op::modify_op(wrl::atom_set& S, const mat4& M) : operation(S)
@@ -112,6 +164,22 @@ wrl::atom_set& wrl::modify_op::redo(wrl::world *w)
     return selection;
 }
 
+// Each step of a drag gives the whole transform since the drag began. Rather
+// than pushing another operation, replace this one's transform with it.
+
+bool wrl::modify_op::amend(wrl::world *w, wrl::atom_set& S, const mat4& M)
+{
+    if (done && S == selection)
+    {
+        w->modify_set(selection, I);
+        T = M;
+        I = inverse(M);
+        w->modify_set(selection, T);
+        return true;
+    }
+    return false;
+}
+
 //-----------------------------------------------------------------------------
 
 wrl::embody_op::embody_op(wrl::atom_set& S, int id) : operation(S)
@@ -141,6 +209,11 @@ wrl::atom_set& wrl::embody_op::redo(wrl::world *w)
     return selection;
 }
 
+size_t wrl::embody_op::size() const
+{
+    return operation::size() + (old_id.size() + new_id.size()) * node_size;
+}
+
 //-----------------------------------------------------------------------------
 
 wrl::enjoin_op::enjoin_op(wrl::atom_set& S) : operation(S), one_id(0),two_id(0)
@@ -196,4 +269,9 @@ wrl::atom_set& wrl::enjoin_op::redo(wrl::world *)
     return selection;
 }
 
+size_t wrl::enjoin_op::size() const
+{
+    return operation::size() + old_id.size() * node_size;
+}
+
 //-----------------------------------------------------------------------------
@@ -39,6 +39,8 @@ wrl::sphere::sphere(app::node node, std::string _fill_name) :
 {
     if (fill)
     {
+        fill->wait();
+
         const vec3 a = fill->get_bound().min();
         const vec3 b = fill->get_bound().max();
 
@@ -57,6 +59,8 @@ wrl::sphere::sphere(app::node node, std::string _fill_name) :
 wrl::box::box(app::node node, std::string _fill_name) :
     solid(node, _fill_name, "wire/wire_box.obj")
 {
+    fill->wait();
+
     length = fill->get_bound().length();
 
     line_scale = length / 2;
@@ -76,6 +80,8 @@ wrl::plane::plane(app::node node, std::string _fill_name) :
 wrl::capsule::capsule(app::node node, std::string _fill_name) :
     solid(node, _fill_name, "wire/wire_cylinder.obj")
 {
+    fill->wait();
+
     const vec3 v = fill->get_bound().length();
 
     radius = std::max(v[0], v[1]) / 2.0;
@@ -89,6 +95,8 @@ wrl::capsule::capsule(app::node node, std::string _fill_name) :
 wrl::cylinder::cylinder(app::node node, std::string _fill_name) :
     solid(node, _fill_name, "wire/wire_cylinder.obj")
 {
+    fill->wait();
+
     const vec3 v = fill->get_bound().length();
 
     radius = std::max(v[0], v[1]) / 2.0;
@@ -12,12 +12,14 @@
 
 #include <algorithm>
 #include <iterator>
+#include <cmath>
 #include <iostream>
 #include <cassert>
 
 #include <etc-log.hpp>
 #include <etc-vector.hpp>
 #include <etc-ode.hpp>
+#include <etc-task.hpp>
 #include <ogl-pool.hpp>
 #include <ogl-uniform.hpp>
 #include <ogl-process.hpp>
@@ -26,38 +28,67 @@
 #include <app-view.hpp>
 #include <app-file.hpp>
 #include <app-frustum.hpp>
+#include <app-event.hpp>
+#include <app-host.hpp>
 #include <wrl-solid.hpp>
 #include <wrl-light.hpp>
 #include <wrl-joint.hpp>
 #include <wrl-world.hpp>
 
-#define MAX_CONTACTS 64
+#define MAX_CONTACTS       64
+#define MIN_PARALLEL_PAIRS 64
 
 //-----------------------------------------------------------------------------
 
 wrl::world::world() :
     serial(1),
+    undo_limit (std::max(1, ::conf->get_i("undo_limit",  256))),
+    undo_memory(size_t(std::max(0, ::conf->get_i("undo_memory", 64))) << 20),
     shadow_splits(::conf->get_i("shadow_map_splits", 3))
 {
     // Initialize the editor physical system.
 
     dInitODE();
 
+    // The picking ray lies outside of the edit space and is tested against it.
+
     edit_space = dHashSpaceCreate(0);
-    edit_point = dCreateRay(edit_space, 1000);
+    edit_point = dCreateRay(0, 1000);
     edit_focus = 0;
+    edit_dirty = true;
+
+    dGeomRaySetClosestHit(edit_point, 1);
 
     play_world = 0;
     play_scene = 0;
     play_actor = 0;
     play_joint = 0;
 
+    play_threading = 0;
+    play_threads   = 0;
+    play_quick     = (::conf->get_i("physics_quick_step", 1) != 0);
+
+    // Initialize the simulation thread state.
+
+    sim_thread = 0;
+    sim_mutex  = SDL_CreateMutex();
+    sim_cond   = SDL_CreateCond();
+    sim_stop   = false;
+    sim_step   = 1.0 / std::max(1, ::conf->get_i("physics_rate", 60));
+    sim_goal   = 0;
+    sim_count  = 0;
+
+    sim_replicate = (::conf->get_i("physics_replicate", 0) != 0);
+    sim_remote    = false;
+
     // Initialize the render pools.
 
-    fill_pool = ::glob->new_pool();
+    const bool packed = (::conf->get_i("packed_vertices", 0) != 0);
+
+    fill_pool = ::glob->new_pool(packed);
     fill_node = new ogl::node;
 
-    line_pool = ::glob->new_pool();
+    line_pool = ::glob->new_pool(packed);
     line_node = new ogl::node;
 
     fill_pool->add_node(fill_node);
@@ -95,6 +126,9 @@ wrl::world::world() :
     process_cookie[2] = ::glob->load_process("cookie", 2);
     process_cookie[3] = ::glob->load_process("cookie", 3);
 
+    for (int i = 0; i < 4; ++i)
+        shadow_frustum[i] = 0;
+
 //  click_selection(new wrl::box("solid/bunny.obj"));
 //  click_selection(new wrl::box("solid/buddha.obj"));
 //  do_create();
@@ -104,6 +138,9 @@ wrl::world::~world()
 {
     play_fini();
 
+    SDL_DestroyCond (sim_cond);
+    SDL_DestroyMutex(sim_mutex);
+
     // Atoms own units, so units must be removed from nodes before deletion.
 
     fill_node->clear();
@@ -192,70 +229,224 @@ void wrl::world::edit_callback(dGeomID o1, dGeomID o2)
     }
 }
 
+// The broad phase notes each candidate pair of geoms on distinct bodies.
+
 void wrl::world::play_callback(dGeomID o1, dGeomID o2)
 {
-    dBodyID b1 = dGeomGetBody(o1);
-    dBodyID b2 = dGeomGetBody(o2);
+    if (dGeomGetBody(o1) != dGeomGetBody(o2))
+        play_pairs.push_back(geom_pair(o1, o2));
+}
+
+void edit_callback(wrl::world *that, dGeomID o1, dGeomID o2)
+{
+    that->edit_callback(o1, o2);
+}
+
+void play_callback(wrl::world *that, dGeomID o1, dGeomID o2)
+{
+    that->play_callback(o1, o2);
+}
+
+//-----------------------------------------------------------------------------
 
-    // Ignore collisions between geoms associated with the same body.
+namespace wrl
+{
+    // Narrow-phase collision of a range of candidate pairs into a private
+    // contact buffer.  Contacts of pair i are contact[first[i]] onward.
 
-    if (b1 != b2)
+    class collide_task : public etc::task
     {
-        dContact contact[MAX_CONTACTS];
-        int sz = sizeof (dContact);
+    public:
 
-        // Check for collisions between these two geoms.
+        collide_task(const geom_pair *p, size_t n) : p(p), n(n) { }
 
-        if (int n = dCollide(o1, o2, MAX_CONTACTS, &contact[0].geom, sz))
+        void run()
         {
-            /* TODO: Reimplement collision triggers with cluster awareness.
-            set_trg(dGeomGetCategoryBits(o1));
-            set_trg(dGeomGetCategoryBits(o2));
-            */
+            dContact buf[MAX_CONTACTS];
 
-            atom *a1 = (atom *) dGeomGetData(o1);
-            atom *a2 = (atom *) dGeomGetData(o2);
+            // Collision may use per-thread ODE data, allocated on first use.
 
-            // Apply the solid surface parameters.
+            dAllocateODEDataForThread(dAllocateMaskAll);
 
-            dSurfaceParameters surface;
+            for (size_t i = 0; i < n; ++i)
+            {
+                int c = dCollide(p[i].first, p[i].second, MAX_CONTACTS,
+                                 &buf[0].geom, sizeof (dContact));
 
-            surface.mode = dContactBounce
-                         | dContactSoftCFM
-                         | dContactSoftERP;
+                first.push_back(contact.size());
+                contact.insert(contact.end(), buf, buf + c);
+            }
+            first.push_back(contact.size());
+        }
 
-            surface.mu         = dInfinity;
-            surface.bounce     = 0.0;
-            surface.bounce_vel = 0.1;
-            surface.soft_erp   = 1.0;
-            surface.soft_cfm   = 0.0;
+        const geom_pair      *p;
+        size_t                n;
+        std::vector<size_t>   first;
+        std::vector<dContact> contact;
+    };
 
-            a1->get_surface(surface);
-            a2->get_surface(surface);
+    typedef std::vector<collide_task> collide_task_v;
+}
 
-            // Create a contact joint for each collision.
+// Collide all candidate pairs, dividing them among the workers if worthwhile.
+// Contact joints are then created serially, in pair order, so that the result
+// does not depend on the timing of the workers.
 
-            for (int i = 0; i < n; ++i)
+void wrl::world::play_collide()
+{
+    play_pairs.clear();
+
+    dSpaceCollide2((dGeomID) play_actor, (dGeomID) play_scene,
+                              this, (dNearCallback *) ::play_callback);
+    dSpaceCollide(play_actor, this, (dNearCallback *) ::play_callback);
+
+    const size_t n = play_pairs.size();
+
+    if (n == 0) return;
+
+    wrl::collide_task_v tasks;
+
+    if (::workers && ::workers->size() && n > MIN_PARALLEL_PAIRS)
+    {
+        const size_t m = std::min(size_t(::workers->size() + 1),
+                                  n / (MIN_PARALLEL_PAIRS / 2));
+        etc::batch batch;
+
+        for (size_t i = 0; i < m; ++i)
+            tasks.push_back(wrl::collide_task(&play_pairs[n * i / m],
+                                n * (i + 1) / m - n * i / m));
+
+        for (wrl::collide_task_v::iterator i = tasks.begin(); i != tasks.end(); ++i)
+            ::workers->push(&(*i), &batch);
+
+        ::workers->wait(&batch);
+    }
+    else
+    {
+        tasks.push_back(wrl::collide_task(&play_pairs.front(), n));
+        tasks.back().run();
+    }
+
+    // Create a contact joint for each collision.
+
+    for (wrl::collide_task_v::iterator t = tasks.begin(); t != tasks.end(); ++t)
+        for (size_t i = 0; i < t->n; ++i)
+            if (t->first[i] < t->first[i + 1])
             {
-                contact[i].surface = surface;
-                dJointAttach(dJointCreateContact(play_world, play_joint,
-                                                 contact + i), b1, b2);
+                dGeomID o1 = t->p[i].first;
+                dGeomID o2 = t->p[i].second;
+                dBodyID b1 = dGeomGetBody(o1);
+                dBodyID b2 = dGeomGetBody(o2);
+
+                /* TODO: Reimplement collision triggers with cluster awareness.
+                set_trg(dGeomGetCategoryBits(o1));
+                set_trg(dGeomGetCategoryBits(o2));
+                */
+
+                atom *a1 = (atom *) dGeomGetData(o1);
+                atom *a2 = (atom *) dGeomGetData(o2);
+
+                // Apply the solid surface parameters.
+
+                dSurfaceParameters surface;
+
+                surface.mode = dContactBounce
+                             | dContactSoftCFM
+                             | dContactSoftERP;
+
+                surface.mu         = dInfinity;
+                surface.bounce     = 0.0;
+                surface.bounce_vel = 0.1;
+                surface.soft_erp   = 1.0;
+                surface.soft_cfm   = 0.0;
+
+                a1->get_surface(surface);
+                a2->get_surface(surface);
+
+                for (size_t j = t->first[i]; j < t->first[i + 1]; ++j)
+                {
+                    t->contact[j].surface = surface;
+                    dJointAttach(dJointCreateContact(play_world, play_joint,
+                                                     &t->contact[j]), b1, b2);
+                }
             }
-        }
-    }
 }
 
-void edit_callback(wrl::world *that, dGeomID o1, dGeomID o2)
-{
-    that->edit_callback(o1, o2);
-}
+//-----------------------------------------------------------------------------
 
-void play_callback(wrl::world *that, dGeomID o1, dGeomID o2)
+// Create a play-mode collision space of the configured type, tuned to the
+// extents of the scene as given by the edit-mode geoms.  A hash space spans
+// cell sizes from the smallest geom to the whole scene.  A sweep-and-prune
+// space sorts along the longest axis first.  A quadtree covers the scene.
+
+dSpaceID wrl::world::new_play_space()
 {
-    that->play_callback(o1, o2);
-}
+    const std::string type = ::conf->get_s("physics_space");
 
-//-----------------------------------------------------------------------------
+    dReal lo[3] = {  dInfinity,  dInfinity,  dInfinity };
+    dReal hi[3] = { -dInfinity, -dInfinity, -dInfinity };
+    dReal sz    =    dInfinity;
+
+    for (int i = 0; i < dSpaceGetNumGeoms(edit_space); ++i)
+    {
+        dGeomID geom = dSpaceGetGeom(edit_space, i);
+        dReal   b[6];
+
+        dGeomGetAABB(geom, b);
+
+        // Unbounded geoms, such as planes, do not count.
+
+        if (b[0] <= -dInfinity || b[1] >= dInfinity ||
+            b[2] <= -dInfinity || b[3] >= dInfinity ||
+            b[4] <= -dInfinity || b[5] >= dInfinity) continue;
+
+        lo[0] = std::min(lo[0], b[0]); hi[0] = std::max(hi[0], b[1]);
+        lo[1] = std::min(lo[1], b[2]); hi[1] = std::max(hi[1], b[3]);
+        lo[2] = std::min(lo[2], b[4]); hi[2] = std::max(hi[2], b[5]);
+
+        sz = std::min(sz, std::max(b[1] - b[0],
+                          std::max(b[3] - b[2], b[5] - b[4])));
+    }
+
+    if (lo[0] > hi[0] || sz <= 0) return dHashSpaceCreate(0);
+
+    const dReal d[3] = { hi[0] - lo[0], hi[1] - lo[1], hi[2] - lo[2] };
+
+    if (type == "sap")
+    {
+        int a[3] = { 0, 1, 2 };
+
+        if (d[a[0]] < d[a[1]]) std::swap(a[0], a[1]);
+        if (d[a[1]] < d[a[2]]) std::swap(a[1], a[2]);
+        if (d[a[0]] < d[a[1]]) std::swap(a[0], a[1]);
+
+        // This is the encoding of ODE's dSAP_AXES constants.
+
+        return dSweepAndPruneSpaceCreate(0, a[0] | (a[1] << 2) | (a[2] << 4));
+    }
+
+    if (type == "quadtree")
+    {
+        dVector3 c;
+        dVector3 e;
+
+        for (int k = 0; k < 3; ++k)
+        {
+            c[k] = (lo[k] + hi[k]) / 2;
+            e[k] = d[k] * dReal(0.55);
+        }
+        return dQuadTreeSpaceCreate(0, c, e,
+                                    ::conf->get_i("physics_space_depth", 6));
+    }
+
+    dSpaceID space = dHashSpaceCreate(0);
+
+    const dReal m = std::max(d[0], std::max(d[1], d[2]));
+
+    dHashSpaceSetLevels(space, int(floor(log(double(sz)) / log(2.0))),
+                               int( ceil(log(double(m))  / log(2.0))));
+    return space;
+}
 
 void wrl::world::play_init()
 {
@@ -264,14 +455,30 @@ void wrl::world::play_init()
     // Create the world, collision spaces, and joint group.
 
     play_world = dWorldCreate();
-    play_scene = dHashSpaceCreate(0);
-    play_actor = dHashSpaceCreate(0);
+    play_scene = new_play_space();
+    play_actor = new_play_space();
     play_joint = dJointGroupCreate(0);
 
     dWorldSetGravity        (play_world, 0, -9.8, 0);
     dWorldSetDamping        (play_world, 0.001, 0.001);
     dWorldSetAutoDisableFlag(play_world, 1);
 
+    // Step independent islands of bodies in parallel, if requested.
+
+    if (int n = ::conf->get_i("physics_threads", 0))
+    {
+        play_threading = dThreadingAllocateMultiThreadedImplementation();
+        play_threads   = dThreadingAllocateThreadPool(n, 0,
+                                                      dAllocateFlagBasicData, 0);
+
+        dThreadingThreadPoolServeMultiThreadedImplementation(play_threads,
+                                                             play_threading);
+        dWorldSetStepIslandsProcessingMaxThreadCount(play_world, n);
+        dWorldSetStepThreadingImplementation(play_world,
+                        dThreadingImplementationGetFunctions(play_threading),
+                                                             play_threading);
+    }
+
     // Create a body and mass for each active entity group.
 
     mass_map play_mass;
@@ -366,10 +573,72 @@ void wrl::world::play_init()
 
     for (atom_set::iterator i = all.begin(); i != all.end(); ++i)
         (*i)->play_init();
+
+    // Note the initial body poses and start the simulation thread.
+
+    for (body_map::iterator b = play_body.begin(); b != play_body.end(); ++b)
+        if (dBodyID body = b->second)
+            if (ogl::node *node = (ogl::node *) dBodyGetData(body))
+            {
+                sim_index[b->first] = int(sim_node.size());
+
+                sim_node.push_back(node);
+                sim_body.push_back(body);
+                sim_id  .push_back(b->first);
+            }
+
+    sim_curr.resize(sim_body.size());
+    play_publish();
+    sim_prev = sim_curr;
+
+    sim_stop   = false;
+    sim_goal   = 0;
+    sim_count  = 0;
+
+    // A replicating client keeps its bodies, which place its geoms, but never
+    // steps them.  A node that sends marks all poses unsent.
+
+    sim_remote = sim_replicate && ::host && !::host->root();
+
+    quant none;
+    memset(&none, 0, sizeof (quant));
+    none.k = -1;
+
+    sim_sent.assign(sim_body.size(), none);
+    sim_pend.clear();
+
+    if (!sim_remote)
+        sim_thread = SDL_CreateThread(sim_loop, "physics", this);
 }
 
 void wrl::world::play_fini()
 {
+    // Stop the simulation thread.
+
+    if (sim_thread)
+    {
+        SDL_LockMutex(sim_mutex);
+        {
+            sim_stop = true;
+            SDL_CondBroadcast(sim_cond);
+        }
+        SDL_UnlockMutex(sim_mutex);
+
+        SDL_WaitThread(sim_thread, 0);
+        sim_thread = 0;
+    }
+
+    sim_node.clear();
+    sim_body.clear();
+    sim_prev.clear();
+    sim_curr.clear();
+    sim_id  .clear();
+    sim_sent.clear();
+    sim_pend.clear();
+    sim_index.clear();
+
+    sim_remote = false;
+
     // Reset all node transforms.
 
     for (node_map::iterator j = nodes.begin(); j != nodes.end(); ++j)
@@ -383,6 +652,17 @@ void wrl::world::play_fini()
     // Clean up the play-mode physics data.
 
     play_body.clear();
+    play_pairs.clear();
+
+    if (play_threading)
+    {
+        dThreadingImplementationShutdownProcessing(play_threading);
+        dThreadingFreeThreadPool(play_threads);
+        dWorldSetStepThreadingImplementation(play_world, 0, 0);
+        dThreadingFreeImplementation(play_threading);
+    }
+    play_threading = 0;
+    play_threads   = 0;
 
     if (play_joint) dJointGroupDestroy(play_joint);
     if (play_scene) dSpaceDestroy     (play_scene);
@@ -395,44 +675,312 @@ void wrl::world::play_fini()
     play_joint = 0;
 }
 
+// Advance the simulation goal by the given time.  The simulation thread takes
+// as many fixed steps as needed to reach it.  Lacking a thread, take them here.
+
 void wrl::world::play_step(double dt)
 {
-    // Do atom-specific physics step initialization.
+    if (sim_remote) return;
 
-    for (atom_set::iterator i = all.begin(); i != all.end(); ++i)
-        (*i)->step_init();
+    SDL_LockMutex(sim_mutex);
+    {
+        sim_goal += dt;
+        SDL_CondBroadcast(sim_cond);
+    }
+    SDL_UnlockMutex(sim_mutex);
+
+    if (sim_thread == 0)
+        while ((sim_count + 1) * sim_step <= sim_goal + 1e-9)
+        {
+            for (atom_set::iterator i = all.begin(); i != all.end(); ++i)
+                (*i)->step_init();
+
+            play_tick();
+            sim_prev.swap(sim_curr);
+            play_publish();
+            sim_count++;
+        }
+}
+
+// Return the interpolant between the last two steps of the simulation, one
+// step behind the goal.  In lockstep, await the simulation reaching it, as all
+// cluster nodes receive the same ticks and so arrive at the same instant.  A
+// replicating root has no peers to agree with, and takes the latest steps as
+// they stand.  The caller holds the mutex.
+
+double wrl::world::sim_alpha(bool wait)
+{
+    const double r = sim_goal - sim_step;
+
+    while (wait && sim_thread && sim_count * sim_step < r - 1e-9)
+        SDL_CondWait(sim_cond, sim_mutex);
+
+    const double t = (r - (sim_count - 1) * sim_step) / sim_step;
+
+    return std::max(0.0, std::min(1.0, t));
+}
+
+wrl::world::pose wrl::world::sim_lerp(size_t i, double a) const
+{
+    pose p;
+
+    p.p =   mix(sim_prev[i].p, sim_curr[i].p, a);
+    p.q = slerp(sim_prev[i].q, sim_curr[i].q, a);
+
+    return p;
+}
+
+// Pose all bodies for rendering, once per frame.  When replicating, the root
+// sends its poses here and clients pose theirs as they receive them.
+
+void wrl::world::play_pose()
+{
+    if (sim_remote) return;
+
+    if (sim_replicate)
+    {
+        play_send();
+        return;
+    }
+
+    SDL_LockMutex(sim_mutex);
+    {
+        const double a = sim_alpha(true);
+
+        for (size_t i = 0; i < sim_node.size(); ++i)
+        {
+            const pose p = sim_lerp(i, a);
+
+            sim_node[i]->transform(translation(p.p) * mat4(mat3(p.q)));
+        }
+    }
+    SDL_UnlockMutex(sim_mutex);
+}
+
+//-----------------------------------------------------------------------------
+
+// Positions are quantized to 1/4096 unit, and quaternion components to 16
+// bits.  The largest quaternion component is made positive and omitted, as it
+// follows from the other three.
+
+#define POSE_P_SCALE 4096.0
+#define POSE_Q_SCALE (32767.0 * 1.41421356237309505)
+
+wrl::world::quant wrl::world::encode(const pose& p)
+{
+    quant c;
+
+    quat q = normal(p.q);
+    int  k = 0;
+
+    for (int i = 1; i < 4; ++i)
+        if (fabs(q[i]) > fabs(q[k]))
+            k = i;
+
+    if (q[k] < 0) q = q * -1.0;
+
+    for (int i = 0, j = 0; i < 4; ++i)
+        if (i != k)
+            c.q[j++] = toint(q[i] * POSE_Q_SCALE);
+
+    c.p[0] = toint(p.p[0] * POSE_P_SCALE);
+    c.p[1] = toint(p.p[1] * POSE_P_SCALE);
+    c.p[2] = toint(p.p[2] * POSE_P_SCALE);
+    c.k    = k;
+
+    return c;
+}
+
+mat4 wrl::world::decode(const quant& c)
+{
+    quat   q;
+    double s = 0;
+
+    for (int i = 0, j = 0; i < 4; ++i)
+        if (i != c.k)
+        {
+            q[i] = c.q[j++] / POSE_Q_SCALE;
+            s   += q[i] * q[i];
+        }
+
+    q[c.k] = sqrt(std::max(0.0, 1.0 - s));
+
+    return translation(vec3(c.p[0] / POSE_P_SCALE,
+                            c.p[1] / POSE_P_SCALE,
+                            c.p[2] / POSE_P_SCALE)) * mat4(mat3(normal(q)));
+}
+
+// Quantize the pose of each body and send those that changed since last sent.
+// The host forwards the events to all clients and then returns them here,
+// where the root ignores them.  Sent during the draw, they reach the clients
+// after this frame's draw event, so clients show them next frame.  The root
+// applies them then too, keeping all screens of the wall identical.
+
+void wrl::world::play_send()
+{
+    std::vector<quant> curr(sim_node.size());
+
+    for (size_t j = 0; j < sim_pend.size(); ++j)
+        sim_node[sim_pend[j]]->transform(decode(sim_sent[sim_pend[j]]));
+
+    sim_pend.clear();
+
+    SDL_LockMutex(sim_mutex);
+    {
+        const double a = sim_alpha(false);
+
+        for (size_t i = 0; i < sim_node.size(); ++i)
+            curr[i] = encode(sim_lerp(i, a));
+    }
+    SDL_UnlockMutex(sim_mutex);
+
+    app::event E;
+
+    E.mk_pose();
+
+    for (size_t i = 0; i < curr.size(); ++i)
+        if (curr[i] != sim_sent[i])
+        {
+            const quant& c = curr[i];
+            const int    n = E.data.pose.n++;
+
+            E.data.pose.id[n]    = sim_id[i];
+            E.data.pose.p [n][0] = c.p[0];
+            E.data.pose.p [n][1] = c.p[1];
+            E.data.pose.p [n][2] = c.p[2];
+            E.data.pose.k [n]    = c.k;
+            E.data.pose.q [n][0] = c.q[0];
+            E.data.pose.q [n][1] = c.q[1];
+            E.data.pose.q [n][2] = c.q[2];
+
+            sim_sent[i] = c;
+            sim_pend.push_back(i);
+
+            if (E.data.pose.n == POSEMAX)
+            {
+                ::host->process_event(&E);
+                E.mk_pose();
+            }
+        }
+
+    if (E.data.pose.n) ::host->process_event(&E);
+}
+
+// Apply received poses, on a client.
+
+void wrl::world::play_recv(app::event *E)
+{
+    if (sim_remote)
+        for (int j = 0; j < E->data.pose.n; ++j)
+        {
+            std::map<int, int>::iterator i = sim_index.find(E->data.pose.id[j]);
+
+            if (i != sim_index.end())
+            {
+                quant c;
+
+                c.p[0] = E->data.pose.p[j][0];
+                c.p[1] = E->data.pose.p[j][1];
+                c.p[2] = E->data.pose.p[j][2];
+                c.k    = E->data.pose.k[j];
+                c.q[0] = E->data.pose.q[j][0];
+                c.q[1] = E->data.pose.q[j][1];
+                c.q[2] = E->data.pose.q[j][2];
+
+                sim_node[i->second]->transform(decode(c));
+            }
+        }
+}
+
+// Copy the current pose of each body.  The caller holds the mutex.
+
+void wrl::world::play_publish()
+{
+    for (size_t i = 0; i < sim_body.size(); ++i)
+    {
+        const dReal *p = dBodyGetPosition  (sim_body[i]);
+        const dReal *q = dBodyGetQuaternion(sim_body[i]);
+
+        sim_curr[i].p = vec3(double(p[0]), double(p[1]), double(p[2]));
+        sim_curr[i].q = quat(double(q[1]), double(q[2]), double(q[3]),
+                                                         double(q[0]));
+    }
+}
+
+int wrl::world::sim_loop(void *data)
+{
+    wrl::world *w = (wrl::world *) data;
+
+    dAllocateODEDataForThread(dAllocateMaskAll);
+
+    SDL_LockMutex(w->sim_mutex);
+
+    while (!w->sim_stop)
+    {
+        if ((w->sim_count + 1) * w->sim_step <= w->sim_goal + 1e-9)
+        {
+            // Step without holding the mutex, then publish the result.
 
+            for (atom_set::iterator i = w->all.begin(); i != w->all.end(); ++i)
+                (*i)->step_init();
+
+            SDL_UnlockMutex(w->sim_mutex);
+            w->play_tick();
+            SDL_LockMutex(w->sim_mutex);
+
+            w->sim_prev.swap(w->sim_curr);
+            w->play_publish();
+            w->sim_count++;
+
+            SDL_CondBroadcast(w->sim_cond);
+        }
+        else SDL_CondWait(w->sim_cond, w->sim_mutex);
+    }
+
+    SDL_UnlockMutex(w->sim_mutex);
+
+    dCleanupODEAllDataForThread();
+
+    return 0;
+}
+
+// Take one fixed step of the physical system.  Atom-specific step
+// initialization reads parameters that the GUI may change, so the caller
+// does it while holding the mutex.
+
+void wrl::world::play_tick()
+{
     // Perform collision detection.
 
     // TODO: move clr_trg somewhere
     // clr_trg();
 
-    dSpaceCollide2((dGeomID) play_actor, (dGeomID) play_scene,
-                              this, (dNearCallback *) ::play_callback);
-    dSpaceCollide(play_actor, this, (dNearCallback *) ::play_callback);
+    play_collide();
 
     // Evaluate the physical system.
 
-    dWorldQuickStep (play_world, dt);
-    dJointGroupEmpty(play_joint);
-
-    // Transform all segments using current ODE state.
+    if (play_quick)
+        dWorldQuickStep(play_world, sim_step);
+    else
+        dWorldStep     (play_world, sim_step);
 
-    for (body_map::iterator b = play_body.begin(); b != play_body.end(); ++b)
-        if (dBodyID body = b->second)
-            if (ogl::node *node = (ogl::node *) dBodyGetData(body))
-                node->transform(bBodyGetTransform(body));
+    dJointGroupEmpty(play_joint);
 }
 
 //-----------------------------------------------------------------------------
 
 void wrl::world::edit_step(double dt)
 {
-    // Perform collision detection.
+    // Cast the picking ray into the edit space, if the ray or scene changed.
 
-    focus_dist = 100;
-    edit_focus =   0;
-    dSpaceCollide(edit_space, this, (dNearCallback *) ::edit_callback);
+    if (edit_dirty)
+    {
+        focus_dist = 100;
+        edit_focus =   0;
+        dSpaceCollide2(edit_point, (dGeomID) edit_space,
+                       this, (dNearCallback *) ::edit_callback);
+        edit_dirty = false;
+    }
 }
 
 void wrl::world::edit_pick(const vec3& p, const vec3& v)
@@ -446,9 +994,17 @@ void wrl::world::edit_pick(const vec3& p, const vec3& v)
     assert(!std::isnan(v[1]));
     assert(!std::isnan(v[2]));
 
-    // Apply the pointer position and vector to the picking ray.
+    // Apply the pointer position and vector to the picking ray, if changed.
+    // The ray normalizes its direction, so compare against the vector given.
 
-    dGeomRaySet(edit_point, p[0], p[1], p[2], v[0], v[1], v[2]);
+    if (edit_p[0] != p[0] || edit_p[1] != p[1] || edit_p[2] != p[2] ||
+        edit_v[0] != v[0] || edit_v[1] != v[1] || edit_v[2] != v[2])
+    {
+        dGeomRaySet(edit_point, p[0], p[1], p[2], v[0], v[1], v[2]);
+        edit_p     = p;
+        edit_v     = v;
+        edit_dirty = true;
+    }
 }
 
 //-----------------------------------------------------------------------------
@@ -470,6 +1026,30 @@ void wrl::world::doop(wrl::operation_p op)
     // Do the operation for the first time.
 
     select_set(op->redo(this));
+
+    trim();
+}
+
+void wrl::world::trim()
+{
+    // Total the memory held by the undo history. Only doop trims, and the
+    // redo history is empty by then.
+
+    size_t s = 0;
+
+    for (operation_i i = undo_list.begin(); i != undo_list.end(); ++i)
+        s += (*i)->size();
+
+    // Delete the oldest undo-able operations until within budget, retaining
+    // the newest regardless.
+
+    while (undo_list.size() > 1 && (undo_list.size() > undo_limit
+                                               || s > undo_memory))
+    {
+        s -= undo_list.back()->size();
+        delete undo_list.back();
+        undo_list.pop_back();
+    }
 }
 
 void wrl::world::undo()
@@ -502,8 +1082,14 @@ void wrl::world::redo()
 
 void wrl::world::set_param(int k, std::string& expr)
 {
-    for (atom_set::iterator i = sel.begin(); i != sel.end(); ++i)
-        (*i)->set_param(k, expr);
+    SDL_LockMutex(sim_mutex);
+    {
+        for (atom_set::iterator i = sel.begin(); i != sel.end(); ++i)
+            (*i)->set_param(k, expr);
+    }
+    SDL_UnlockMutex(sim_mutex);
+
+    edit_dirty = true;
 }
 
 int wrl::world::get_param(int k, std::string& expr)
@@ -675,6 +1261,7 @@ void wrl::world::create_set(atom_set& set)
 
         (*i)->transform(mat4());
     }
+    edit_dirty = true;
 }
 
 void wrl::world::delete_set(atom_set& set)
@@ -690,6 +1277,7 @@ void wrl::world::delete_set(atom_set& set)
         all.erase(all.find(*i));
         (*i)->dead(edit_space);
     }
+    edit_dirty = true;
 }
 
 void wrl::world::embody_set(atom_set& set, atom_map& map)
@@ -712,6 +1300,8 @@ void wrl::world::modify_set(atom_set& set, const mat4& T)
 
     for (atom_set::iterator i = set.begin(); i != set.end(); ++i)
         (*i)->transform(T);
+
+    edit_dirty = true;
 }
 
 //-----------------------------------------------------------------------------
@@ -779,9 +1369,20 @@ void wrl::world::do_debody()
     if (!sel.empty()) doop(new wrl::embody_op(sel, 0));
 }
 
-void wrl::world::do_modify(const mat4& M)
+void wrl::world::do_modify(const mat4& M, bool amend)
 {
-    if (!sel.empty()) doop(new wrl::modify_op(sel, M));
+    // An amendment supersedes the latest modification, if it is of the same
+    // selection. Otherwise, push a new one.
+
+    if (!sel.empty())
+    {
+        if (amend && redo_list.empty()
+                  && !undo_list.empty()
+                  && undo_list.front()->amend(this, sel, M))
+            return;
+
+        doop(new wrl::modify_op(sel, M));
+    }
 }
 
 //-----------------------------------------------------------------------------
@@ -913,6 +1514,25 @@ void wrl::world::save(std::string filename, bool save_all)
 
 //-----------------------------------------------------------------------------
 
+// Cache the visibility of the given pool in all of the given frusta, testing
+// them in a single traversal. Return the visible bound.
+
+static ogl::aabb view_pool(ogl::pool *pool, int frusc,
+                           const app::frustum *const *frusv)
+{
+    std::vector<const vec4 *> planes;
+
+    for (int frusi = 0; frusi < frusc; ++frusi)
+        planes.push_back(frusv[frusi]->get_world_planes());
+
+    if (planes.empty())
+        return ogl::aabb();
+    else
+        return pool->view(0, frusc, &planes.front(), 5);
+}
+
+//-----------------------------------------------------------------------------
+
 ogl::aabb wrl::world::prep_fill(int frusc, const app::frustum *const *frusv)
 {
     // Set the highlight uniform.
@@ -937,10 +1557,9 @@ ogl::aabb wrl::world::prep_fill(int frusc, const app::frustum *const *frusv)
 
     // Cache the fill visibility and determine the visible bound.
 
-    ogl::aabb bb;
+    fill_bound = view_pool(fill_pool, frusc, frusv);
 
-    for (int frusi = 0; frusi < frusc; ++frusi)
-        bb.merge(fill_pool->view(frusi, frusv[frusi]->get_world_planes(), 5));
+    ogl::aabb bb = fill_bound;
 
     bb.inflate(1.01);
     return bb;
@@ -954,10 +1573,7 @@ ogl::aabb wrl::world::prep_line(int frusc, const app::frustum *const *frusv)
 
     // Cache the line visibility and determine the visible bound.
 
-    ogl::aabb bb;
-
-    for (int frusi = 0; frusi < frusc; ++frusi)
-        bb.merge(line_pool->view(frusi, frusv[frusi]->get_world_planes(), 5));
+    ogl::aabb bb = view_pool(line_pool, frusc, frusv);
 
     bb.inflate(1.01);
     return bb;
@@ -968,12 +1584,11 @@ ogl::aabb wrl::world::prep_line(int frusc, const app::frustum *const *frusv)
 // Set all light parameters and render the light source shadow map.
 
 void wrl::world::set_light(int light, const vec4& p,
-                           int frusi, app::frustum *frusp)
+                           int frusi, app::frustum *frusp,
+                           const ogl::aabb& bound)
 {
     // Bound the frustum to its visible volume.
 
-    ogl::aabb bound = fill_pool->view(frusi, frusp->get_world_planes(), 5);
-
     frusp->set_bound(mat4(), bound);
 
     // Render the fill geometry to the shadow buffer.
@@ -1010,16 +1625,14 @@ void wrl::world::set_light(int light, const vec4& p,
     uniform_light [light]->set(V * p);
 }
 
-// Add a spot light source.
+// Add a spot light source.  Its shadow map is rendered once all are added.
 
-int wrl::world::s_light(int light, const vec3& p, const vec3& v, double c,
-                        int frusc, const app::frustum *const *frusv,
-                                   const ogl::aabb& visible)
+int wrl::world::s_light(int light, const vec3& p, const vec3& v, double c)
 {
     if (light < 4)
     {
-        app::perspective_frustum frust(p, -v, c, 1);
-        set_light(light, vec4(p, 1), frusc + light, &frust);
+        shadow_frustum [light] = new app::perspective_frustum(p, -v, c, 1);
+        shadow_position[light] = vec4(p, 1);
 
         uniform_split[light]->set(vec2(0, 1));
 
@@ -1028,13 +1641,15 @@ int wrl::world::s_light(int light, const vec3& p, const vec3& v, double c,
     return 0;
 }
 
-// Add a directional light source.
+// Add a directional light source.  Its shadow maps are rendered once all are
+// added.
 
 int wrl::world::d_light(int light, const vec3& p, const vec3& v, double c,
                         int frusc, const app::frustum *const *frusv,
                                    const ogl::aabb& visible)
 {
     const int n = shadow_splits;
+    const int l = light;
 
     for (int i = 0; i < n && light < 4; i++, light++)
     {
@@ -1047,24 +1662,21 @@ int wrl::world::d_light(int light, const vec3& p, const vec3& v, double c,
 
         bound.intersect(visible);
 
-        // Render a shadow map encompasing this bound.
+        // Add a shadow map encompasing this bound.
 
-        app::orthogonal_frustum frust(bound, v);
-        set_light(light, vec4(v, 0), frusc + light, &frust);
+        shadow_frustum [light] = new app::orthogonal_frustum(bound, v);
+        shadow_position[light] = vec4(v, 0);
 
         uniform_split[light]->set(vec2(double(i) / n, double(i + 1) / n));
     }
-    return n;
+    return light - l;
 }
 
 void wrl::world::lite(int frusc, const app::frustum *const *frusv)
 {
-    // Determine the visible bounding volume. TODO: Remove this redundancy.
-
-    ogl::aabb bound;
+    // The visible bounding volume was determined during the prep.
 
-    for (int frusi = 0; frusi < frusc; ++frusi)
-        bound.merge(fill_pool->view(frusi, frusv[frusi]->get_world_planes(), 5));
+    const ogl::aabb& bound = fill_bound;
 
     // Enumerate the light sources.
 
@@ -1097,7 +1709,7 @@ void wrl::world::lite(int frusc, const app::frustum *const *frusv)
 
                 switch ((*a)->priority())
                 {
-                case -1: n += s_light(l, p, v, c, frusc, frusv, bound); break;
+                case -1: n += s_light(l, p, v, c);                      break;
                 case -2: n += d_light(l, p, v, c, frusc, frusv, bound); break;
                 }
 
@@ -1115,6 +1727,27 @@ void wrl::world::lite(int frusc, const app::frustum *const *frusv)
         }
     }
 
+    // Cull all shadow frusta in a single traversal.  Render the shadow maps.
+
+    if (l > 0)
+    {
+        const vec4 *planes[4];
+        ogl::aabb   bounds[4];
+
+        for (int i = 0; i < l; i++)
+            planes[i] = shadow_frustum[i]->get_world_planes();
+
+        fill_pool->view(frusc, l, planes, 5, bounds);
+
+        for (int i = 0; i < l; i++)
+        {
+            set_light(i, shadow_position[i], frusc + i, shadow_frustum[i], bounds[i]);
+
+            delete shadow_frustum[i];
+            shadow_frustum[i] = 0;
+        }
+    }
+
     uniform_spot->set(spot);
     uniform_unit->set(unit);
 